@@ -43,6 +43,7 @@ struct mbuf_private {
     /* don't use `struct tcp_seg` directly to avoid conflicts by include lwip tcp header */
     char ts[32]; // 32 > sizeof(struct tcp_seg)
     struct latency_timestamp lt;
+    uint8_t tx_backlog; /* set while the packet waits in a stack tx backlog */
 };
 
 static __rte_always_inline struct mbuf_private *mbuf_to_private(const struct rte_mbuf *m)
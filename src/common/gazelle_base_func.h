@@ -43,6 +43,7 @@ int32_t check_and_set_run_dir(void);
 int32_t filename_check(const char* args);
 
 void gazelle_exit(void);
+void gazelle_network_start(void);
 
 /* Do not check if the type of ptr and type->member are the same */
 #define container_of_uncheck_ptr(ptr, type, member) \
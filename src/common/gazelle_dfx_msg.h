@@ -61,6 +61,7 @@ enum GAZELLE_STAT_MODE {
     GAZELLE_STAT_LSTACK_SHOW_AGGREGATE,
     GAZELLE_STAT_LSTACK_SHOW_NIC_FEATURES,
     GAZELLE_STAT_LSTACK_SHOW_INTR,
+    GAZELLE_STAT_LSTACK_SHOW_MEM,
 
 #ifdef GAZELLE_FAULT_INJECT_ENABLE
     GAZELLE_STAT_FAULT_INJECT_SET,
@@ -111,6 +112,17 @@ struct gazelle_stack_stat {
     uint64_t accept_fail;
     uint64_t sock_rx_drop;
     uint64_t sock_tx_merge;
+    uint64_t tx_backlog;
+    uint64_t tx_backlog_drop;
+    uint64_t timer_run_max_us;
+    uint64_t mbuf_cache_hit;
+    uint64_t mbuf_cache_miss;
+    uint64_t mbuf_ring_low;
+    uint64_t gro_pkts;
+    uint64_t gro_merged;
+    uint64_t rx_cksum_bad;
+    uint64_t udp_gso_segs;
+    uint64_t syn_drop;
 };
 
 struct gazelle_wakeup_stat {
@@ -136,6 +148,7 @@ struct gazelle_stack_aggregate_stats {
 
 struct gazelle_stat_pkts {
     uint16_t conn_num;
+    uint32_t stack_load;
     uint32_t mbufpool_avail_cnt;
     uint64_t call_msg_cnt;
     uint64_t recv_list_cnt;
@@ -265,6 +278,8 @@ struct gazelle_stat_lstack_conn_info {
     uint32_t recv_cnt;
     uint32_t send_ring_cnt;
     uint32_t recv_ring_cnt;
+    uint32_t send_ring_idle; // mbufs allocated in send_ring but not yet written by app
+    uint32_t sock_mem; // bytes of socket rings and the mbufs held in them
     uint32_t tcp_sub_state;
 
     uint32_t cwn;
@@ -346,6 +361,21 @@ struct nic_eth_features {
     uint64_t tx_offload;
 };
 
+struct numa_mem_stats {
+    int32_t numa_id; // -1: memory not bound to a node
+    uint32_t stack_num;
+    uint32_t mempool_num;
+    uint64_t mempool_bytes;
+    uint64_t heap_total;
+    uint64_t heap_alloc;
+};
+
+struct gazelle_stat_lstack_mem {
+#define NUMA_MEM_STAT_MAX 9 // GAZELLE_MAX_NUMA_NODES and one entry for SOCKET_ID_ANY
+    uint32_t node_num;
+    struct numa_mem_stats node[NUMA_MEM_STAT_MAX];
+};
+
 struct interrupt_stats {
     uint64_t virtio_user_event_cnt;
     uint64_t nic_event_cnt;
@@ -372,6 +402,7 @@ struct gazelle_stack_dfx_data {
         struct nic_eth_features nic_features;
         struct gazelle_stat_lstack_proto  proto_data;
         struct interrupt_stats intr_stats;
+        struct gazelle_stat_lstack_mem mem_stats;
 
 #ifdef GAZELLE_FAULT_INJECT_ENABLE
         struct gazelle_fault_inject_data inject;
@@ -19,6 +19,8 @@
 #include <stdatomic.h>
 #include <pthread.h>
 
+#include <rte_pause.h>
+
 #include <lwip/sockets.h>
 #include <lwip/lwipgz_posix_api.h>
 
@@ -36,6 +38,20 @@
 #define SEC_TO_MSEC             1000
 #define MSEC_TO_NSEC            1000000
 #define POLL_KERNEL_EVENTS      32
+#define POLL_MAX_FDS            (GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS)
+#define POLL_READY_WORDS        ((POLL_MAX_FDS + 63) / 64)
+#define POLL_SUMMARY_WORDS      ((POLL_READY_WORDS + 63) / 64)
+
+/* rtw: per fd node of wakeup->ready_queue, queued avoids pushing one socket again before app drains it.
+ * wakeup is the ready_queue the node was last pushed to, epoll_ctl takes it back from there.
+ * dead is set by a stack thread closing the socket, the next drain of the owner drops the stale push. */
+struct sock_event_node {
+    lockless_queue_node node;
+    struct wakeup_poll *wakeup;
+    bool queued;
+    bool dead;
+};
+static struct sock_event_node g_sock_event_nodes[POLL_MAX_FDS];
 
 static void update_epoll_max_stack(struct wakeup_poll *wakeup);
 static void change_epollfd_kernel_thread(struct wakeup_poll *wakeup, struct protocol_stack *old_stack,
@@ -73,6 +89,132 @@ void add_sock_event_nolock(struct lwip_sock *sock, uint32_t event)
     return;
 }
 
+static inline int32_t sock_event_fd(const struct lwip_sock *sock)
+{
+    return (sock->conn == NULL) ? -1 : sock->conn->callback_arg.socket;
+}
+
+static void add_sock_event_lockless(struct lwip_sock *sock, struct wakeup_poll *wakeup, uint32_t event)
+{
+    int32_t fd = sock_event_fd(sock);
+
+    if (fd < 0 || fd >= POLL_MAX_FDS) {
+        if (wakeup->type == WAKEUP_POLL) {
+            return;
+        }
+        pthread_spin_lock(&wakeup->event_list_lock);
+        add_sock_event_nolock(sock, event);
+        pthread_spin_unlock(&wakeup->event_list_lock);
+        return;
+    }
+
+    if ((event & sock->epoll_events) == 0) {
+        return;
+    }
+    if (event == EPOLLIN && !NETCONN_IS_DATAIN(sock) && !NETCONN_IS_ACCEPTIN(sock)) {
+        return;
+    }
+    if (event == EPOLLOUT && !NETCONN_IS_OUTIDLE(sock)) {
+        return;
+    }
+
+    __atomic_fetch_or(&sock->events, (event == EPOLLERR) ? (EPOLLIN | EPOLLERR) : (event & sock->epoll_events),
+        __ATOMIC_RELEASE);
+
+    /* poll: one bit per fd, poll thread moves it into event_list on next call */
+    if (wakeup->type == WAKEUP_POLL) {
+        __atomic_fetch_or(&wakeup->ready_bits[fd / 64], 1ULL << (fd % 64), __ATOMIC_RELEASE);
+        __atomic_fetch_or(&wakeup->ready_summary[fd / 64 / 64], 1ULL << (fd / 64 % 64), __ATOMIC_RELEASE);
+        return;
+    }
+
+    struct sock_event_node *ev_node = &g_sock_event_nodes[fd];
+    if (__atomic_exchange_n(&ev_node->queued, true, __ATOMIC_SEQ_CST)) {
+        return;
+    }
+
+    /* pairs with reclaim_sock_event_node: a sock moved by epoll_ctl meanwhile goes to its new epoll */
+    struct wakeup_poll *cur = __atomic_load_n(&sock->wakeup, __ATOMIC_SEQ_CST);
+    if (cur != wakeup) {
+        if (cur == NULL || cur->type != WAKEUP_EPOLL) {
+            __atomic_store_n(&ev_node->queued, false, __ATOMIC_RELEASE);
+            return;
+        }
+        wakeup = cur;
+        add_wakeup_to_stack_wakeuplist(wakeup, sock->stack);
+    }
+    __atomic_store_n(&ev_node->wakeup, wakeup, __ATOMIC_RELEASE);
+    lockless_queue_mpsc_push(&wakeup->ready_queue, &ev_node->node);
+}
+
+/* called by app thread with event_list_lock held */
+static void drain_sock_ready_queue(struct wakeup_poll *wakeup)
+{
+    lockless_queue_node *node;
+
+    while ((node = lockless_queue_mpsc_pop(&wakeup->ready_queue)) != NULL) {
+        struct sock_event_node *ev_node = container_of(node, struct sock_event_node, node);
+        bool dead = __atomic_exchange_n(&ev_node->dead, false, __ATOMIC_ACQUIRE);
+        /* clear before reading sock, later event of this sock will queue it again */
+        __atomic_store_n(&ev_node->wakeup, NULL, __ATOMIC_RELAXED);
+        __atomic_store_n(&ev_node->queued, false, __ATOMIC_RELEASE);
+
+        struct lwip_sock *sock = lwip_get_socket(ev_node - g_sock_event_nodes);
+        if (POSIX_IS_CLOSED(sock) || sock->wakeup != wakeup) {
+            continue;
+        }
+        /* pushed for a closed socket, a new socket of the fd only counts if it has events of its own */
+        if (dead && __atomic_load_n(&sock->events, __ATOMIC_ACQUIRE) == 0) {
+            continue;
+        }
+        if (list_node_null(&sock->event_list)) {
+            list_add_node(&sock->event_list, &wakeup->event_list);
+        }
+    }
+}
+
+/*
+ * take the node of fd back from a ready_queue other than sock->wakeup's, after sock->wakeup was changed.
+ * otherwise it stays queued on the old epoll and blocks every push to the new one until the old is drained.
+ */
+void reclaim_sock_event_node(struct lwip_sock *sock, int32_t fd)
+{
+    if (fd < 0 || fd >= POLL_MAX_FDS) {
+        return;
+    }
+
+    struct sock_event_node *ev_node = &g_sock_event_nodes[fd];
+    struct wakeup_poll *target = sock->wakeup;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&ev_node->queued, __ATOMIC_SEQ_CST)) {
+        struct wakeup_poll *owner = __atomic_load_n(&ev_node->wakeup, __ATOMIC_ACQUIRE);
+        if (owner != NULL && owner == target) {
+            break;
+        }
+        /* owner is NULL while a stack thread is between queued and push, the push completes shortly */
+        if (owner != NULL) {
+            pthread_spin_lock(&owner->event_list_lock);
+            drain_sock_ready_queue(owner);
+            pthread_spin_unlock(&owner->event_list_lock);
+        }
+        rte_pause();
+    }
+}
+
+/* called by stack thread closing the socket, it must not wait for the app that owns the ready_queue */
+void release_sock_event_node(int32_t fd)
+{
+    if (fd < 0 || fd >= POLL_MAX_FDS) {
+        return;
+    }
+
+    struct sock_event_node *ev_node = &g_sock_event_nodes[fd];
+    if (__atomic_load_n(&ev_node->queued, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&ev_node->dead, true, __ATOMIC_RELEASE);
+    }
+}
+
 static void _add_sock_event(struct lwip_sock *sock, struct wakeup_poll *wakeup, uint32_t event)
 {
     struct protocol_stack *stack = sock->stack;
@@ -88,10 +230,9 @@ static void _add_sock_event(struct lwip_sock *sock, struct wakeup_poll *wakeup,
         return;
     }
 
-    if (wakeup->type == WAKEUP_EPOLL) {
-        pthread_spin_lock(&wakeup->event_list_lock);
-        add_sock_event_nolock(sock, event);
-        pthread_spin_unlock(&wakeup->event_list_lock);
+    /* recv_block wakeup only needs the sem post, the ready list belongs to sock->wakeup */
+    if ((wakeup->type == WAKEUP_EPOLL || wakeup->type == WAKEUP_POLL) && wakeup == sock->wakeup) {
+        add_sock_event_lockless(sock, wakeup, event);
     }
 
     add_wakeup_to_stack_wakeuplist(wakeup, stack);
@@ -109,11 +250,18 @@ void del_sock_event_nolock(struct lwip_sock *sock, uint32_t event)
     if (get_global_cfg_params()->stack_mode_rtc) {
         sock->events &= ~event;
     } else {
+        /* stack thread raises events without lock, check again after clear to not lose one */
         if ((event & EPOLLOUT) && !NETCONN_IS_OUTIDLE(sock)) {
-            sock->events &= ~EPOLLOUT;
+            __atomic_fetch_and(&sock->events, ~EPOLLOUT, __ATOMIC_ACQ_REL);
+            if (NETCONN_IS_OUTIDLE(sock)) {
+                __atomic_fetch_or(&sock->events, EPOLLOUT & sock->epoll_events, __ATOMIC_RELEASE);
+            }
         }
         if ((event & EPOLLIN) && !NETCONN_IS_DATAIN(sock) && !NETCONN_IS_ACCEPTIN(sock)) {
-            sock->events &= ~EPOLLIN;
+            __atomic_fetch_and(&sock->events, ~EPOLLIN, __ATOMIC_ACQ_REL);
+            if (NETCONN_IS_DATAIN(sock) || NETCONN_IS_ACCEPTIN(sock)) {
+                __atomic_fetch_or(&sock->events, EPOLLIN & sock->epoll_events, __ATOMIC_RELEASE);
+            }
         }
     }
 
@@ -221,8 +369,9 @@ static void raise_pending_events(struct wakeup_poll *wakeup, struct lwip_sock *s
     }
 
     if (event) {
-        sock->events = event;
-        if (wakeup->type == WAKEUP_EPOLL && (sock->events & sock->epoll_events) &&
+        /* stack threads or events into sock->events without lock */
+        event |= __atomic_fetch_or(&sock->events, event, __ATOMIC_ACQ_REL);
+        if (wakeup->type == WAKEUP_EPOLL && (event & sock->epoll_events) &&
             list_node_null(&sock->event_list)) {
             list_add_node(&sock->event_list, &wakeup->event_list);
             rte_mb();
@@ -271,6 +420,7 @@ int32_t lstack_do_epoll_create(int32_t fd)
 
     list_init_head(&wakeup->event_list);
     pthread_spin_init(&wakeup->event_list_lock, PTHREAD_PROCESS_PRIVATE);
+    lockless_queue_init(&wakeup->ready_queue);
 
     wakeup->type = WAKEUP_EPOLL;
     wakeup->epollfd = fd;
@@ -336,6 +486,8 @@ int32_t lstack_epoll_close(int32_t fd)
 
     struct list_node *node, *temp;
     pthread_spin_lock(&wakeup->event_list_lock);
+    /* stack threads have seen WAKEUP_CLOSE after clean_epoll, nothing is pushed any more */
+    drain_sock_ready_queue(wakeup);
     list_for_each_node(node, temp, &wakeup->event_list) {
         struct lwip_sock *sock = list_entry(node, struct lwip_sock, event_list);
         list_del_node(&sock->event_list);
@@ -461,7 +613,9 @@ int32_t lstack_rtw_epoll_ctl(int32_t epfd, int32_t op, int32_t fd, struct epoll_
     do {
         switch (op) {
             case EPOLL_CTL_ADD:
-                sock->wakeup = wakeup;
+                __atomic_store_n(&sock->wakeup, wakeup, __ATOMIC_SEQ_CST);
+                /* shadow socks of listen_next have fds of their own */
+                reclaim_sock_event_node(sock, sock_event_fd(sock));
                 wakeup->stack_fd_cnt[sock->stack->stack_idx]++;
                 /* fall through */
             case EPOLL_CTL_MOD:
@@ -473,6 +627,7 @@ int32_t lstack_rtw_epoll_ctl(int32_t epfd, int32_t op, int32_t fd, struct epoll_
                 sock->epoll_events = 0;
                 wakeup->stack_fd_cnt[sock->stack->stack_idx]--;
                 pthread_spin_lock(&wakeup->event_list_lock);
+                drain_sock_ready_queue(wakeup);
                 list_del_node(&sock->event_list);
                 pthread_spin_unlock(&wakeup->event_list_lock);
                 break;
@@ -506,14 +661,15 @@ int32_t epoll_lwip_event_nolock(struct wakeup_poll *wakeup, struct epoll_event *
             break;
         }
         
-        events[event_num].events = sock->events & sock->epoll_events;
-        events[event_num].data = sock->ep_data;
-        event_num++;
-
         if (sock->epoll_events & EPOLLET) {
             list_del_node(node);
-            sock->events = 0;
+            /* exchange, event raised by stack thread after this point is kept for next wait */
+            events[event_num].events = __atomic_exchange_n(&sock->events, 0, __ATOMIC_ACQ_REL) & sock->epoll_events;
+        } else {
+            events[event_num].events = sock->events & sock->epoll_events;
         }
+        events[event_num].data = sock->ep_data;
+        event_num++;
 
         /* EPOLLONESHOT: generate event after epoll_ctl add/mod event again
            epoll_event set 0 avoid generating event util epoll_ctl reset epoll_event */
@@ -531,6 +687,7 @@ static int32_t epoll_lwip_event(struct wakeup_poll *wakeup, struct epoll_event *
     int32_t event_num;
 
     pthread_spin_lock(&wakeup->event_list_lock);
+    drain_sock_ready_queue(wakeup);
     event_num = epoll_lwip_event_nolock(wakeup, events, maxevents);
     pthread_spin_unlock(&wakeup->event_list_lock);
 
@@ -639,20 +796,28 @@ int32_t lstack_rtc_epoll_wait(int32_t epfd, struct epoll_event* events, int32_t
         return posix_api->epoll_wait_fn(epfd, events, maxevents, timeout);
     }
 
+    if (events == NULL || maxevents <= 0) {
+        GAZELLE_RETURN(EINVAL);
+    }
+
     struct wakeup_poll *wakeup = sock->wakeup;
+    struct protocol_stack *stack = get_protocol_stack();
+    uint32_t rx_batch = get_global_cfg_params()->rtc_epoll_rx_batch;
+    uint64_t rx_start = stack->stats.rx;
+    uint64_t rx_last;
     int32_t lwip_num = 0;
-    /* 16: avoid app process events for a long time */
-    int32_t tmpmaxevents = 16;
     /* avoid the starvation of epoll events from both netstack */
-    int host_maxevents = tmpmaxevents / 2;
+    int host_maxevents = (maxevents > 1) ? (maxevents / 2) : 1;
     uint32_t poll_ts = sys_now();
     bool loop_flag;
     int32_t kernel_num = 0;
     int32_t tmptimeout = timeout;
 
     do {
+        rx_last = stack->stats.rx;
         stack_polling(0);
-        if (__atomic_load_n(&wakeup->have_kernel_event, __ATOMIC_ACQUIRE)) {
+        /* fetch kernel events once, a later pass of the rx batch must not overwrite them in events[] */
+        if (kernel_num == 0 && __atomic_load_n(&wakeup->have_kernel_event, __ATOMIC_ACQUIRE)) {
             kernel_num = posix_api->epoll_wait_fn(epfd, events, host_maxevents, 0);
             if (!kernel_num) {
                 __atomic_store_n(&wakeup->have_kernel_event, false, __ATOMIC_RELEASE);
@@ -668,6 +833,10 @@ int32_t lstack_rtc_epoll_wait(int32_t epfd, struct epoll_event* events, int32_t
         if (!kernel_num && list_head_empty(&wakeup->event_list) && tmptimeout != 0) {
             loop_flag = true;
         }
+        /* batch mode: keep receiving until rx budget is used up or nic queue is drained, then harvest once */
+        if (rx_batch != 0 && stack->stats.rx != rx_last && stack->stats.rx - rx_start < rx_batch) {
+            loop_flag = true;
+        }
     } while (loop_flag);
 
     if (kernel_num < 0) {
@@ -675,7 +844,7 @@ int32_t lstack_rtc_epoll_wait(int32_t epfd, struct epoll_event* events, int32_t
         return kernel_num;
     }
 
-    lwip_num = epoll_lwip_event_nolock(wakeup, &events[kernel_num], tmpmaxevents - kernel_num);
+    lwip_num = epoll_lwip_event_nolock(wakeup, &events[kernel_num], maxevents - kernel_num);
     wakeup->stat.app_events += lwip_num;
     wakeup->stat.kernel_events += kernel_num;
 
@@ -731,6 +900,18 @@ static int32_t init_poll_wakeup_data(struct wakeup_poll *wakeup)
     }
     __atomic_store_n(&wakeup->in_wait, false, __ATOMIC_RELEASE);
 
+    list_init_head(&wakeup->event_list);
+    pthread_spin_init(&wakeup->event_list_lock, PTHREAD_PROCESS_PRIVATE);
+    wakeup->poll_index = calloc(POLL_MAX_FDS, sizeof(uint32_t));
+    wakeup->ready_bits = calloc(POLL_READY_WORDS, sizeof(uint64_t));
+    wakeup->ready_summary = calloc(POLL_SUMMARY_WORDS, sizeof(uint64_t));
+    if (wakeup->poll_index == NULL || wakeup->ready_bits == NULL || wakeup->ready_summary == NULL) {
+        free(wakeup->poll_index);
+        free(wakeup->ready_bits);
+        free(wakeup->ready_summary);
+        GAZELLE_RETURN(EINVAL);
+    }
+
     for (uint32_t i = 0; i < PROTOCOL_STACK_MAX; i++) {
         list_init_node(&wakeup->wakeup_list[i]);
     }
@@ -828,12 +1009,128 @@ static void update_kernel_poll(struct wakeup_poll *wakeup, uint32_t index, struc
     }
 }
 
+/* sock is fds[slot].fd itself or one of its listen shadow */
+static bool poll_slot_match(const struct pollfd *pfd, const struct lwip_sock *sock)
+{
+    struct lwip_sock *head = lwip_get_socket(pfd->fd);
+
+    while (!POSIX_IS_CLOSED(head)) {
+        if (head == sock) {
+            return true;
+        }
+        head = head->listen_next;
+    }
+    return false;
+}
+
+static void poll_register_sock(struct wakeup_poll *wakeup, struct lwip_sock *sock,
+    const struct pollfd *fds, nfds_t nfds, uint32_t slot)
+{
+    int32_t fd = (sock->conn == NULL) ? -1 : sock->conn->callback_arg.socket;
+    uint32_t events;
+
+    if (fd < 0 || fd >= POLL_MAX_FDS) {
+        wakeup->poll_scan_all = true;
+        return;
+    }
+
+    uint32_t old = wakeup->poll_index[fd];
+    if (old != 0 && old - 1 != slot && old - 1 < nfds && poll_slot_match(&fds[old - 1], sock)) {
+        wakeup->poll_scan_all = true;
+    }
+    wakeup->poll_index[fd] = slot + 1;
+
+    /* no event will come for data already arrived, raise it now */
+    events = update_events(sock);
+    pthread_spin_lock(&wakeup->event_list_lock);
+    __atomic_store_n(&sock->events, events, __ATOMIC_RELEASE);
+    if (events != 0 && list_node_null(&sock->event_list)) {
+        list_add_node(&sock->event_list, &wakeup->event_list);
+    }
+    pthread_spin_unlock(&wakeup->event_list_lock);
+}
+
+/* only the ready sockets are visited, instead of every watched fd */
+static int32_t poll_lwip_ready_event(struct wakeup_poll *wakeup, struct pollfd *fds, nfds_t nfds)
+{
+    struct list_node *node, *temp;
+    int32_t event_num = 0;
+
+    pthread_spin_lock(&wakeup->event_list_lock);
+
+    /* the summary has one bit per ready_bits word, clean words are not read */
+    for (uint32_t s = 0; s < POLL_SUMMARY_WORDS; s++) {
+        if (__atomic_load_n(&wakeup->ready_summary[s], __ATOMIC_ACQUIRE) == 0) {
+            continue;
+        }
+        uint64_t words = __atomic_exchange_n(&wakeup->ready_summary[s], 0, __ATOMIC_ACQ_REL);
+        while (words != 0) {
+            uint32_t w = s * 64 + __builtin_ctzll(words);
+            words &= words - 1;
+
+            uint64_t bits = __atomic_exchange_n(&wakeup->ready_bits[w], 0, __ATOMIC_ACQ_REL);
+            while (bits != 0) {
+                struct lwip_sock *sock = lwip_get_socket(w * 64 + __builtin_ctzll(bits));
+                bits &= bits - 1;
+                if (!POSIX_IS_CLOSED(sock) && sock->wakeup == wakeup && list_node_null(&sock->event_list)) {
+                    list_add_node(&sock->event_list, &wakeup->event_list);
+                }
+            }
+        }
+    }
+
+    list_for_each_node(node, temp, &wakeup->event_list) {
+        struct lwip_sock *sock = list_entry(node, struct lwip_sock, event_list);
+        int32_t fd = (sock->conn == NULL) ? -1 : sock->conn->callback_arg.socket;
+        uint32_t slot = (fd < 0 || fd >= POLL_MAX_FDS) ? 0 : wakeup->poll_index[fd];
+
+        /* stale: fd removed from fds or no longer ready, an event will add it again */
+        if (slot == 0 || slot > nfds || !poll_slot_match(&fds[slot - 1], sock)) {
+            list_del_node(node);
+            continue;
+        }
+        uint32_t events = update_events(sock);
+        if (events == 0) {
+            list_del_node(node);
+            continue;
+        }
+
+        if (fds[slot - 1].revents == 0) {
+            event_num++;
+        }
+        fds[slot - 1].revents |= events;
+    }
+
+    pthread_spin_unlock(&wakeup->event_list_lock);
+    return event_num;
+}
+
+static bool poll_fds_same(const struct wakeup_poll *wakeup, const struct pollfd *fds, nfds_t nfds)
+{
+    if (nfds != wakeup->last_nfds) {
+        return false;
+    }
+    for (uint32_t i = 0; i < nfds; i++) {
+        if (fds[i].fd != wakeup->last_fds[i].fd || fds[i].events != wakeup->last_fds[i].events) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static int poll_init(struct wakeup_poll *wakeup, struct pollfd *fds, nfds_t nfds)
 {
     int32_t stack_count[PROTOCOL_STACK_MAX] = {0};
     int32_t poll_change = 0;
+    bool reregister = false;
     int ret = 0;
 
+    /* full scan holds while the same fds are polled, a changed set is registered again from scratch */
+    if (wakeup->poll_scan_all && !poll_fds_same(wakeup, fds, nfds)) {
+        wakeup->poll_scan_all = false;
+        reregister = true;
+    }
+
     /* poll fds num more, recalloc fds size */
     if (nfds > wakeup->last_max_nfds) {
         ret = resize_kernel_poll(wakeup, nfds);
@@ -852,7 +1149,7 @@ static int poll_init(struct wakeup_poll *wakeup, struct pollfd *fds, nfds_t nfds
         fds[i].revents = 0;
         struct lwip_sock *sock = lwip_get_socket(fd);
 
-        if (fd == wakeup->last_fds[i].fd && fds[i].events == wakeup->last_fds[i].events) {
+        if (!reregister && fd == wakeup->last_fds[i].fd && fds[i].events == wakeup->last_fds[i].events) {
             /* fd close then socket may get same fd. */
             if (sock == NULL || sock->wakeup != NULL) {
                 continue;
@@ -871,6 +1168,7 @@ static int poll_init(struct wakeup_poll *wakeup, struct pollfd *fds, nfds_t nfds
             sock->epoll_events = fds[i].events | POLLERR;
             sock->wakeup = wakeup;
             stack_count[sock->stack->stack_idx]++;
+            poll_register_sock(wakeup, sock, fds, nfds, i);
             sock = sock->listen_next;
         }
     }
@@ -919,9 +1217,14 @@ int32_t lstack_poll(struct pollfd *fds, nfds_t nfds, int32_t timeout)
     int32_t kernel_num = 0;
     int32_t lwip_num = 0;
 
+    /* revents are cleared by poll_init */
     do {
         __atomic_store_n(&wakeup->in_wait, true, __ATOMIC_RELEASE);
-        lwip_num = poll_lwip_event(fds, nfds);
+        if (wakeup->poll_scan_all) {
+            lwip_num = poll_lwip_event(fds, nfds);
+        } else {
+            lwip_num = poll_lwip_ready_event(wakeup, fds, nfds);
+        }
 
         if (__atomic_load_n(&wakeup->have_kernel_event, __ATOMIC_ACQUIRE)) {
             kernel_num = posix_api->epoll_wait_fn(wakeup->epollfd, wakeup->events, nfds, 0);
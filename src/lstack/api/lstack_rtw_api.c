@@ -22,6 +22,9 @@
 #include "lstack_epoll.h"
 #include "lstack_rtw_api.h"
 
+/* listen_reuseport: host order port registered by each listen fd, 0 means not registered */
+static uint16_t g_reuseport_listen_port[GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS];
+
 /* when fd is listenfd, listenfd of all protocol stack thread will be closed */
 static int stack_broadcast_close(int fd)
 {
@@ -116,20 +119,6 @@ static int stack_broadcast_bind(int fd, const struct sockaddr *name, socklen_t n
     return 0;
 }
 
-static void inline del_accept_in_event(struct lwip_sock *sock)
-{
-    pthread_spin_lock(&sock->wakeup->event_list_lock);
-
-    if (!NETCONN_IS_ACCEPTIN(sock)) {
-        sock->events &= ~EPOLLIN;
-        if (sock->events == 0) {
-            list_del_node(&sock->event_list);
-        }
-    }
-
-    pthread_spin_unlock(&sock->wakeup->event_list_lock);
-}
-
 static struct lwip_sock *get_min_accept_sock(int fd)
 {
     struct lwip_sock *sock = lwip_get_socket(fd);
@@ -150,7 +139,7 @@ static struct lwip_sock *get_min_accept_sock(int fd)
             continue;
         }
 
-        if (min_sock == NULL || min_sock->stack->conn_num > sock->stack->conn_num) {
+        if (min_sock == NULL || stack_load_less(sock->stack, min_sock->stack)) {
             min_sock = sock;
         }
 
@@ -188,7 +177,8 @@ static int stack_broadcast_accept4(int fd, struct sockaddr *addr, socklen_t *add
     }
 
     if (min_sock && min_sock->wakeup && min_sock->wakeup->type == WAKEUP_EPOLL) {
-        del_accept_in_event(min_sock);
+        /* EPOLLIN of listen sock is raised without lock, del_sock_event clears it safely */
+        del_sock_event(min_sock, EPOLLIN);
     }
 
     if (ret < 0) {
@@ -212,6 +202,47 @@ static int stack_single_listen(int fd, int backlog)
     return rpc_call_listen(&stack->rpc_queue, fd, backlog);
 }
 
+/* listen only in the stack of current app thread, packets of this port arriving at
+ * stacks without a listener are steered by tuple hash to one of the listening stacks */
+static int stack_reuseport_listen(int fd, int backlog)
+{
+    struct sockaddr_in6 addr;
+    socklen_t addr_len = sizeof(addr);
+    struct protocol_stack *stack = get_protocol_stack_by_fd(fd);
+    int ret;
+
+    if (stack == NULL) {
+        GAZELLE_RETURN(EBADF);
+    }
+
+    ret = rpc_call_listen(&stack->rpc_queue, fd, backlog);
+    if (ret != 0) {
+        return ret;
+    }
+
+    ret = rpc_call_getsockname(&stack->rpc_queue, fd, (struct sockaddr *)&addr, &addr_len);
+    if (ret != 0) {
+        return ret;
+    }
+
+    /* sin_port and sin6_port share the same offset */
+    g_reuseport_listen_port[fd] = ntohs(addr.sin6_port);
+    stack_reuseport_add(g_reuseport_listen_port[fd], stack->stack_idx);
+    return 0;
+}
+
+static void stack_reuseport_close(int fd)
+{
+    struct protocol_stack *stack = get_protocol_stack_by_fd(fd);
+
+    if (stack == NULL || g_reuseport_listen_port[fd] == 0) {
+        return;
+    }
+
+    stack_reuseport_del(g_reuseport_listen_port[fd], stack->stack_idx);
+    g_reuseport_listen_port[fd] = 0;
+}
+
 /* listen sync to all protocol stack thread, so that any protocol stack thread can build connect */
 static int stack_broadcast_listen(int fd, int backlog)
 {
@@ -301,6 +332,10 @@ static int rtw_bind(int s, const struct sockaddr *name, socklen_t namelen)
 
 static int rtw_listen(int s, int backlog)
 {
+    if (get_global_cfg_params()->listen_reuseport) {
+        return stack_reuseport_listen(s, backlog);
+    }
+
     if (!get_global_cfg_params()->tuple_filter &&
         !get_global_cfg_params()->listen_shadow) {
         return stack_single_listen(s, backlog);
@@ -324,6 +359,9 @@ static int rtw_setsockopt(int s, int level, int optname, const void *optval, soc
     if (stack == NULL) {
         GAZELLE_RETURN(EBADF);
     }
+    if (level == IPPROTO_UDP && optname == UDP_SEGMENT) {
+        return do_lwip_set_udp_gso(s, optval, optlen);
+    }
     return rpc_call_setsockopt(&stack->rpc_queue, s, level, optname, optval, optlen);
 }
 
@@ -333,6 +371,9 @@ static int rtw_getsockopt(int s, int level, int optname, void *optval, socklen_t
     if (stack == NULL) {
         GAZELLE_RETURN(EBADF);
     }
+    if (level == IPPROTO_UDP && optname == UDP_SEGMENT) {
+        return do_lwip_get_udp_gso(s, optval, optlen);
+    }
     return rpc_call_getsockopt(&stack->rpc_queue, s, level, optname, optval, optlen);
 }
 
@@ -488,6 +529,9 @@ static int rtw_close(int s)
     if (sock && sock->wakeup && sock->wakeup->epollfd == s) {
         return lstack_epoll_close(s);
     }
+    if (get_global_cfg_params()->listen_reuseport) {
+        stack_reuseport_close(s);
+    }
     return stack_broadcast_close(s);
 }
 
@@ -191,11 +191,22 @@ pid_t lstack_fork(void)
     pid_t pid;
 
     pid = posix_api->fork_fn();
-    /* child not support lwip */
-    if (pid == 0) {
-        pthread_unblock_sig(SIGUSR1);
-        pthread_unblock_sig(SIGUSR2);
-        posix_api->use_kernel = 1;
+    if (pid != 0) {
+        return pid;
     }
+
+    pthread_unblock_sig(SIGUSR1);
+    pthread_unblock_sig(SIGUSR2);
+
+    /* parent never started lstack, child owns dpdk as a fresh primary.
+     * only one child gets it, the others fail the process lock and stay in kernel.
+     * the choice is by fork order: a daemonizing fork hands lstack to the daemon, not to a worker */
+    if (get_global_cfg_params()->fork_defer_init && posix_api->use_kernel) {
+        gazelle_network_start();
+        return pid;
+    }
+
+    /* child of a running lstack not support lwip */
+    posix_api->use_kernel = 1;
     return pid;
 }
@@ -15,6 +15,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <fcntl.h>
+#include <string.h>
 #include <linux/if_xdp.h>
 
 #include <lwip/lwipgz_posix_api.h>
@@ -57,6 +58,37 @@ void wrap_api_exit(void)
     dummy_api_init(g_wrap_api);
 }
 
+#define WRAP_FD_CACHE_MAX (GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS)
+/* fd -> lwip_sock. lwip sockets are fd indexed, so the sock of a fd never moves once looked up,
+ * hot data calls skip lwip_get_socket() and select_sock_posix_path() for pure lwip fds. */
+static struct lwip_sock *g_wrap_fd_sock[WRAP_FD_CACHE_MAX];
+
+static inline struct lwip_sock *wrap_get_socket(int32_t fd)
+{
+    struct lwip_sock *sock;
+
+    if (unlikely((uint32_t)fd >= WRAP_FD_CACHE_MAX)) {
+        return lwip_get_socket(fd);
+    }
+
+    sock = g_wrap_fd_sock[fd];
+    if (unlikely(sock == NULL)) {
+        sock = lwip_get_socket(fd);
+        g_wrap_fd_sock[fd] = sock;
+    }
+    return sock;
+}
+
+static inline bool wrap_fd_is_lwip(int32_t fd)
+{
+    struct lwip_sock *sock = wrap_get_socket(fd);
+
+    if (likely(!POSIX_IS_CLOSED(sock) && POSIX_IS_TYPE(sock, POSIX_LWIP))) {
+        return true;
+    }
+    return select_sock_posix_path(sock) == POSIX_LWIP;
+}
+
 static inline int32_t do_epoll_create1(int32_t flags)
 {
     if (select_posix_path() == POSIX_KERNEL) {
@@ -510,9 +542,49 @@ static bool unsupport_optname(int32_t level, int32_t optname)
     }
 }
 
+/* lwip has only its built-in newreno congestion control, report it as linux names it
+ * instead of the algorithm of the kernel socket that merely reserves the fd */
+#define LWIP_TCP_CA_NAME        "reno"
+#define LWIP_TCP_CA_NAME_MAX    16
+
+static int32_t lwip_get_tcp_congestion(void *optval, socklen_t *optlen)
+{
+    char name[LWIP_TCP_CA_NAME_MAX] = LWIP_TCP_CA_NAME;
+
+    if (optval == NULL || optlen == NULL) {
+        GAZELLE_RETURN(EFAULT);
+    }
+    socklen_t len = LWIP_MIN(*optlen, sizeof(name));
+    if (len > 0 && memcpy_s(optval, len, name, len) != EOK) {
+        GAZELLE_RETURN(EFAULT);
+    }
+    *optlen = len;
+    return 0;
+}
+
+static int32_t lwip_set_tcp_congestion(const void *optval, socklen_t optlen)
+{
+    char name[LWIP_TCP_CA_NAME_MAX] = {0};
+
+    if (optval == NULL || optlen == 0) {
+        GAZELLE_RETURN(EINVAL);
+    }
+    if (memcpy_s(name, sizeof(name) - 1, optval, LWIP_MIN(optlen, sizeof(name) - 1)) != EOK) {
+        GAZELLE_RETURN(EFAULT);
+    }
+    if (strcmp(name, LWIP_TCP_CA_NAME) != 0) {
+        GAZELLE_RETURN(ENOENT);
+    }
+    return 0;
+}
+
 static inline int32_t do_getsockopt(int32_t s, int32_t level, int32_t optname, void *optval, socklen_t *optlen)
 {
 #define SO_NUMA_ID 0x100c
+    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP && level == IPPROTO_TCP &&
+        optname == TCP_CONGESTION) {
+        return lwip_get_tcp_congestion(optval, optlen);
+    }
     if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP && !unsupport_optname(level, optname)) {
         if (level == IPPROTO_IP && optname == SO_NUMA_ID) {
             return lwip_get_socket(s)->stack->numa_id;
@@ -525,6 +597,10 @@ static inline int32_t do_getsockopt(int32_t s, int32_t level, int32_t optname, v
 
 static inline int32_t do_setsockopt(int32_t s, int32_t level, int32_t optname, const void *optval, socklen_t optlen)
 {
+    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP && level == IPPROTO_TCP &&
+        optname == TCP_CONGESTION) {
+        return lwip_set_tcp_congestion(optval, optlen);
+    }
     if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_KERNEL || unsupport_optname(level, optname)) {
         return posix_api->setsockopt_fn(s, level, optname, optval, optlen);
     }
@@ -571,7 +647,7 @@ static inline ssize_t do_recv(int32_t sockfd, void *buf, size_t len, int32_t fla
         return 0;
     }
 
-    if (select_sock_posix_path(lwip_get_socket(sockfd)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(sockfd)) {
         return g_wrap_api->recv_fn(sockfd, buf, len, flags);
     }
     return posix_api->recv_fn(sockfd, buf, len, flags);
@@ -586,7 +662,7 @@ static inline ssize_t do_read(int32_t s, void *mem, size_t len)
         return 0;
     }
 
-    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(s)) {
         return g_wrap_api->read_fn(s, mem, len);
     }
     return posix_api->read_fn(s, mem, len);
@@ -594,7 +670,7 @@ static inline ssize_t do_read(int32_t s, void *mem, size_t len)
 
 static inline ssize_t do_readv(int32_t s, const struct iovec *iov, int iovcnt)
 {
-    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(s)) {
         return g_wrap_api->readv_fn(s, iov, iovcnt);
     }
     return posix_api->readv_fn(s, iov, iovcnt);
@@ -602,7 +678,7 @@ static inline ssize_t do_readv(int32_t s, const struct iovec *iov, int iovcnt)
 
 static inline ssize_t do_send(int32_t sockfd, const void *buf, size_t len, int32_t flags)
 {
-    if (select_sock_posix_path(lwip_get_socket(sockfd)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(sockfd)) {
         return g_wrap_api->send_fn(sockfd, buf, len, flags);
     }
     return posix_api->send_fn(sockfd, buf, len, flags);
@@ -610,7 +686,7 @@ static inline ssize_t do_send(int32_t sockfd, const void *buf, size_t len, int32
 
 static inline ssize_t do_write(int32_t s, const void *mem, size_t size)
 {
-    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(s)) {
         return g_wrap_api->write_fn(s, mem, size);
     }
     return posix_api->write_fn(s, mem, size);
@@ -618,7 +694,7 @@ static inline ssize_t do_write(int32_t s, const void *mem, size_t size)
 
 static inline ssize_t do_writev(int32_t s, const struct iovec *iov, int iovcnt)
 {
-    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(s)) {
         return g_wrap_api->writev_fn(s, iov, iovcnt);
     }
     return posix_api->writev_fn(s, iov, iovcnt);
@@ -630,7 +706,7 @@ static inline ssize_t do_recvmsg(int32_t s, struct msghdr *message, int32_t flag
         GAZELLE_RETURN(EINVAL);
     }
 
-    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(s)) {
         return g_wrap_api->recvmsg_fn(s, message, flags);
     }
     return posix_api->recvmsg_fn(s, message, flags);
@@ -642,7 +718,7 @@ static inline ssize_t do_sendmsg(int32_t s, const struct msghdr *message, int32_
         GAZELLE_RETURN(EINVAL);
     }
 
-    if (select_sock_posix_path(lwip_get_socket(s)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(s)) {
         return g_wrap_api->sendmsg_fn(s, message, flags);
     }
     return posix_api->sendmsg_fn(s, message, flags);
@@ -658,7 +734,7 @@ static inline ssize_t do_recvfrom(int32_t sockfd, void *buf, size_t len, int32_t
         return 0;
     }
 
-    if (select_sock_posix_path(lwip_get_socket(sockfd)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(sockfd)) {
         return g_wrap_api->recvfrom_fn(sockfd, buf, len, flags, addr, addrlen);
     }
     return posix_api->recvfrom_fn(sockfd, buf, len, flags, addr, addrlen);
@@ -667,7 +743,7 @@ static inline ssize_t do_recvfrom(int32_t sockfd, void *buf, size_t len, int32_t
 static inline ssize_t do_sendto(int32_t sockfd, const void *buf, size_t len, int32_t flags,
                                 const struct sockaddr *addr, socklen_t addrlen)
 {
-    if (select_sock_posix_path(lwip_get_socket(sockfd)) == POSIX_LWIP) {
+    if (wrap_fd_is_lwip(sockfd)) {
         return g_wrap_api->sendto_fn(sockfd, buf, len, flags, addr, addrlen);
     }
     return posix_api->sendto_fn(sockfd, buf, len, flags, addr, addrlen);
@@ -45,6 +45,8 @@
 #define DEV_PCI_ADDR_LEN     12
 #define BOND_MIIMON_MIN      1
 #define BOND_MIIMON_MAX      INT_MAX
+/* gro table is flushed every poll, it never holds more than one nic read */
+#define GRO_TABLE_READ_RATIO 4
 
 static struct cfg_params g_config_params;
 
@@ -88,7 +90,18 @@ static int32_t parse_nic_vlan_mode(void);
 static int32_t parse_rpc_msg_max(void);
 static int32_t parse_send_cache_mode(void);
 static int32_t parse_flow_bifurcation(void);
+static int32_t parse_flow_bifurcation_thread(void);
+static int32_t parse_fork_defer_init(void);
+static int32_t parse_conn_compact(void);
+static int32_t parse_gro_max_flow_num(void);
+static int32_t parse_gro_max_item_per_flow(void);
+static int32_t parse_rx_sw_cksum(void);
+static int32_t parse_syn_watermark(void);
+static int32_t parse_rss_rebalance_interval(void);
 static int32_t parse_stack_interrupt(void);
+static int32_t parse_stack_rebalance(void);
+static int32_t parse_listen_reuseport(void);
+static int32_t parse_rtc_epoll_rx_batch(void);
 static int32_t parse_stack_num(void);
 static int32_t parse_xdp_eth_name(void);
 
@@ -159,6 +172,17 @@ static struct config_vector_t g_config_tbl[] = {
     { "send_cache_mode", parse_send_cache_mode },
     { "flow_bifurcation", parse_flow_bifurcation},
     { "stack_interrupt", parse_stack_interrupt},
+    { "stack_rebalance", parse_stack_rebalance},
+    { "listen_reuseport", parse_listen_reuseport},
+    { "rtc_epoll_rx_batch", parse_rtc_epoll_rx_batch},
+    { "flow_bifurcation_thread", parse_flow_bifurcation_thread},
+    { "fork_defer_init", parse_fork_defer_init},
+    { "conn_compact", parse_conn_compact},
+    { "gro_max_flow_num", parse_gro_max_flow_num},
+    { "gro_max_item_per_flow", parse_gro_max_item_per_flow},
+    { "rx_sw_cksum", parse_rx_sw_cksum},
+    { "syn_watermark", parse_syn_watermark},
+    { "rss_rebalance_interval", parse_rss_rebalance_interval},
     { NULL,           NULL }
 };
 
@@ -1461,6 +1485,129 @@ static int32_t parse_flow_bifurcation(void)
     return ret;
 }
 
+static int32_t parse_flow_bifurcation_thread(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.flow_bifurcation_thread, "flow_bifurcation_thread", false, false, true, ret);
+    if (ret != 0 || !g_config_params.flow_bifurcation_thread) {
+        return ret;
+    }
+
+    if (!g_config_params.flow_bifurcation) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "flow_bifurcation_thread need flow_bifurcation enabled.\n");
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int32_t parse_fork_defer_init(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.fork_defer_init, "fork_defer_init", false, false, true, ret);
+    if (ret != 0 || !g_config_params.fork_defer_init) {
+        return ret;
+    }
+
+    if (g_config_params.use_ltran || !g_config_params.is_primary) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "fork_defer_init only support primary process without ltran.\n");
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int32_t parse_conn_compact(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.conn_compact, "conn_compact", false, false, true, ret);
+    return ret;
+}
+
+static int32_t parse_gro_max_flow_num(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.gro_max_flow_num, "gro_max_flow_num", 8, 1, 4096, ret);
+    return ret;
+}
+
+static int32_t parse_gro_max_item_per_flow(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.gro_max_item_per_flow, "gro_max_item_per_flow", 16, 1, 64, ret);
+    if (ret != 0) {
+        return ret;
+    }
+
+    uint64_t bound = (uint64_t)g_config_params.nic_read_number * GRO_TABLE_READ_RATIO;
+    if ((uint64_t)g_config_params.gro_max_flow_num * g_config_params.gro_max_item_per_flow <= bound) {
+        return 0;
+    }
+
+    if (config_lookup(&g_config, "gro_max_flow_num") != NULL ||
+        config_lookup(&g_config, "gro_max_item_per_flow") != NULL) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "gro_max_flow_num * gro_max_item_per_flow should not exceed %d * nic_read_number.\n",
+            GRO_TABLE_READ_RATIO);
+        return -EINVAL;
+    }
+
+    /* defaults shrink with a small nic_read_number, items per flow first */
+    g_config_params.gro_max_item_per_flow = (uint32_t)((bound / g_config_params.gro_max_flow_num > 0) ?
+        bound / g_config_params.gro_max_flow_num : 1);
+    if ((uint64_t)g_config_params.gro_max_flow_num * g_config_params.gro_max_item_per_flow > bound) {
+        g_config_params.gro_max_flow_num = (uint32_t)bound;
+    }
+    return 0;
+}
+
+static int32_t parse_rx_sw_cksum(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.rx_sw_cksum, "rx_sw_cksum", false, false, true, ret);
+    if (ret != 0 || !g_config_params.rx_sw_cksum) {
+        return ret;
+    }
+
+    /* packets from ltran do not pass vdev_rx_poll */
+    if (g_config_params.use_ltran) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "rx_sw_cksum not support ltran.\n");
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int32_t parse_syn_watermark(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.syn_watermark, "syn_watermark", 0, 0, 100, ret);
+    if (ret != 0 || g_config_params.syn_watermark == 0) {
+        return ret;
+    }
+
+    /* packets from ltran do not pass eth_dev_poll classify */
+    if (g_config_params.use_ltran) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "syn_watermark not support ltran.\n");
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static int32_t parse_rss_rebalance_interval(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.rss_rebalance_interval, "rss_rebalance_interval", 0, 0, 3600, ret);
+    if (ret != 0 || g_config_params.rss_rebalance_interval == 0) {
+        return ret;
+    }
+
+    /* the reta is owned by one primary process and steers to stack threads it polls */
+    if (g_config_params.use_ltran || g_config_params.tuple_filter ||
+        g_config_params.stack_mode_rtc || g_config_params.num_process > 1) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "rss_rebalance_interval not support ltran, tuple_filter, "
+            "stack_mode_rtc or num_process > 1.\n");
+        return -EINVAL;
+    }
+    return 0;
+}
+
 static int32_t parse_stack_interrupt(void)
 {
     int32_t ret;
@@ -1484,6 +1631,41 @@ static int32_t parse_stack_interrupt(void)
     return ret;
 }
 
+static int32_t parse_stack_rebalance(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.stack_rebalance, "stack_rebalance", false, false, true, ret);
+    return ret;
+}
+
+static int32_t parse_listen_reuseport(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.listen_reuseport, "listen_reuseport", false, false, true, ret);
+    if (ret != 0 || !g_config_params.listen_reuseport) {
+        return ret;
+    }
+
+    if (g_config_params.listen_shadow || g_config_params.tuple_filter || g_config_params.use_ltran) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "listen_reuseport and (listen_shadow or tuple_filter or ltran) "
+                       "cannot be enabled at the same time\n");
+        return -EINVAL;
+    }
+    if (g_config_params.stack_mode_rtc) {
+        LSTACK_PRE_LOG(LSTACK_ERR, "rtc mode not support listen_reuseport.\n");
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static int32_t parse_rtc_epoll_rx_batch(void)
+{
+    int32_t ret;
+    PARSE_ARG(g_config_params.rtc_epoll_rx_batch, "rtc_epoll_rx_batch", 0, 0, 65535, ret);
+    return ret;
+}
+
 static int dpdk_dev_get_iface_name(char *vdev_str)
 {
     char *token = NULL;
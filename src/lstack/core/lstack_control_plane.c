@@ -601,7 +601,8 @@ static int32_t handle_stat_request(int32_t sockfd)
         msg.stat_mode == GAZELLE_STAT_LSTACK_LOW_POWER_MDF) {
         return handle_proc_cmd(sockfd, &msg);
     } else if (msg.stat_mode == GAZELLE_STAT_LSTACK_SHOW_XSTATS ||
-        msg.stat_mode == GAZELLE_STAT_LSTACK_SHOW_NIC_FEATURES) {
+        msg.stat_mode == GAZELLE_STAT_LSTACK_SHOW_NIC_FEATURES ||
+        msg.stat_mode == GAZELLE_STAT_LSTACK_SHOW_MEM) {
         return handle_dpdk_cmd(sockfd, msg.stat_mode);
     } else {
         ret = handle_stack_cmd(sockfd, &msg);
@@ -11,6 +11,9 @@
 */
 
 #include <sched.h>
+#include <unistd.h>
+#include <time.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <securec.h>
 #include <pthread.h>
@@ -65,12 +68,34 @@ struct eth_params {
 };
 
 static struct eth_params g_eth_params;
+
+#define RSS_HASH_KEY_LEN    40
+#define RX_PTYPE_MAX        64
+
+/* rss_rebalance supports nic reta up to this size */
+#define RSS_REBALANCE_RETA_MAX      RTE_ETH_RSS_RETA_SIZE_512
+/* at most this many buckets are moved per round */
+#define RSS_REBALANCE_MOVE_MAX      8
+/* rebalance when the hottest queue has more than 1/4 of its packets over the coolest */
+#define RSS_REBALANCE_IMBALANCE     4
+/* exit waits this long for a round stuck on a stack that already stopped */
+#define RSS_REBALANCE_STOP_WAIT_S   3
+
+/* queue of each reta bucket as programmed into the nic, rss_rebalance moves buckets at runtime */
+static uint16_t g_reta_queue[RSS_REBALANCE_RETA_MAX];
+/* rx tcp packets of each reta bucket, each stack counts its own row */
+static uint32_t g_reta_pkts[PROTOCOL_STACK_MAX][RSS_REBALANCE_RETA_MAX];
+/* rx udp packets of each reta bucket, a bucket with udp traffic stays while a bound udp socket exists */
+static uint32_t g_reta_udp[PROTOCOL_STACK_MAX][RSS_REBALANCE_RETA_MAX];
+static bool g_rss_rebalance = false;
+static bool g_rss_rebalance_stop = false;
+static bool g_rss_rebalance_running = false;
+static pthread_t g_rss_rebalance_tid;
 #if RTE_VERSION < RTE_VERSION_NUM(23, 11, 0, 0)
 struct rte_kni;
 static struct rte_bus *g_pci_bus = NULL;
 #endif
 
-#define RSS_HASH_KEY_LEN    40
 static uint8_t g_default_rss_key[] = {
     0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
     0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
@@ -226,6 +251,22 @@ int32_t pktmbuf_pool_init(struct protocol_stack *stack)
     return 0;
 }
 
+/* rte_socket_id() is SOCKET_ID_ANY for threads not pinned by eal, such as app threads */
+int32_t dpdk_thread_numa_id(void)
+{
+    int32_t numa_id = (int32_t)rte_socket_id();
+    if (numa_id != SOCKET_ID_ANY) {
+        return numa_id;
+    }
+
+    int32_t cpu_id = sched_getcpu();
+    if (cpu_id < 0) {
+        return SOCKET_ID_ANY;
+    }
+    numa_id = numa_node_of_cpu(cpu_id);
+    return (numa_id < 0) ? SOCKET_ID_ANY : numa_id;
+}
+
 struct rte_mempool *create_mempool(const char *name, uint32_t count, uint32_t size,
     uint32_t flags, int32_t idx)
 {
@@ -239,7 +280,7 @@ struct rte_mempool *create_mempool(const char *name, uint32_t count, uint32_t si
     }
 
     mempool = rte_mempool_create(pool_name, count, size,
-        0, 0, NULL, NULL, NULL, NULL, rte_socket_id(), flags);
+        0, 0, NULL, NULL, NULL, NULL, dpdk_thread_numa_id(), flags);
     if (mempool == NULL) {
         LSTACK_LOG(ERR, LSTACK, "%s create failed. errno: %d.\n", name, rte_errno);
     }
@@ -272,19 +313,133 @@ int32_t create_shared_ring(struct protocol_stack *stack)
     return 0;
 }
 
+/*
+ * each lcore cache may hold up to 1.5 * cache_size mbufs of every pool it touches,
+ * so keep the caches of all stacks within a quarter of the pool beyond the reserve.
+ */
+uint32_t dpdk_mbuf_cache_size(uint32_t nb_mbuf)
+{
+    struct cfg_params *cfg = get_global_cfg_params();
+    uint32_t stack_num = cfg->num_queue > 0 ? cfg->num_queue : 1;
+    uint32_t spare = (nb_mbuf > MBUFPOOL_RESERVE_NUM) ? nb_mbuf - MBUFPOOL_RESERVE_NUM : 0;
+    uint32_t bound = spare / (4 * stack_num) * 2 / 3;
+    uint32_t cache_size;
+
+    /* prefer room for one nic read burst, but the quarter-of-pool bound always wins */
+    cache_size = RTE_MAX(RTE_MIN(bound, (uint32_t)RXTX_CACHE_SZ),
+        RTE_MIN(cfg->nic_read_number, (uint32_t)RXTX_CACHE_SZ));
+    return RTE_MIN(cache_size, bound);
+}
+
+/* threads that are not eal lcores (stack_num mode) have no cache in the pool, they get a private one */
+static PER_THREAD struct rte_mempool_cache *g_mbuf_cache = NULL;
+static PER_THREAD struct rte_mempool *g_mbuf_cache_pool = NULL;
+
+int32_t dpdk_mbuf_cache_init(struct rte_mempool *pool)
+{
+    if (rte_lcore_id() != LCORE_ID_ANY || g_mbuf_cache != NULL) {
+        return 0;
+    }
+
+    g_mbuf_cache = rte_mempool_cache_create(pool->cache_size > 0 ? pool->cache_size : RXTX_CACHE_SZ,
+        dpdk_thread_numa_id());
+    if (g_mbuf_cache == NULL) {
+        LSTACK_LOG(ERR, LSTACK, "rte_mempool_cache_create failed. errno: %d.\n", rte_errno);
+        return -1;
+    }
+    g_mbuf_cache_pool = pool;
+    return 0;
+}
+
+/* must run on the thread that called dpdk_mbuf_cache_init, the cached mbufs go back to the pool */
+void dpdk_mbuf_cache_exit(void)
+{
+    if (g_mbuf_cache == NULL) {
+        return;
+    }
+
+    rte_mempool_cache_flush(g_mbuf_cache, g_mbuf_cache_pool);
+    rte_mempool_cache_free(g_mbuf_cache);
+    g_mbuf_cache = NULL;
+    g_mbuf_cache_pool = NULL;
+}
+
+/* rte_mempool_in_use_count only sees lcore caches, the private cache of this thread holds free mbufs too */
+uint32_t dpdk_mbuf_in_use_count(struct rte_mempool *pool)
+{
+    uint32_t in_use = rte_mempool_in_use_count(pool);
+
+    if (pool == g_mbuf_cache_pool && g_mbuf_cache != NULL) {
+        in_use -= RTE_MIN(in_use, g_mbuf_cache->len);
+    }
+    return in_use;
+}
+
+static inline struct rte_mempool_cache *dpdk_mbuf_cache(struct rte_mempool *pool, bool *user_cache)
+{
+    struct rte_mempool_cache *cache = rte_mempool_default_cache(pool, rte_lcore_id());
+
+    *user_cache = (cache == NULL && pool == g_mbuf_cache_pool);
+    return *user_cache ? g_mbuf_cache : cache;
+}
+
+void dpdk_free_pktmbuf_seg(struct rte_mbuf *mbuf)
+{
+    bool user_cache;
+
+    mbuf = rte_pktmbuf_prefree_seg(mbuf);
+    if (mbuf == NULL) {
+        return;
+    }
+    rte_mempool_generic_put(mbuf->pool, (void **)&mbuf, 1, dpdk_mbuf_cache(mbuf->pool, &user_cache));
+}
+
+static inline void mbuf_cache_stat(struct rte_mempool *pool, const struct rte_mempool_cache *cache, uint32_t num)
+{
+    struct protocol_stack *stack = get_protocol_stack();
+    if (stack == NULL) {
+        return;
+    }
+
+    if (cache != NULL && cache->len >= num) {
+        stack->stats.mbuf_cache_hit++;
+        return;
+    }
+
+    stack->stats.mbuf_cache_miss++;
+    /* a miss goes to the backing store anyway, so sampling its level here costs no extra hot path work */
+    if (rte_mempool_ops_get_count(pool) < MBUFPOOL_RESERVE_NUM + num) {
+        stack->stats.mbuf_ring_low++;
+    }
+}
+
 int32_t dpdk_alloc_pktmbuf(struct rte_mempool *pool, struct rte_mbuf **mbufs, uint32_t num, bool reserve)
 {
-    if (reserve) {
-        /*
-         * don't use rte_mempool_avail_count, it traverse cpu local cache,
-         * when RTE_MAX_LCORE is too large, it's time-consuming
-         */
+    int32_t ret;
+    bool user_cache;
+    struct rte_mempool_cache *cache = dpdk_mbuf_cache(pool, &user_cache);
+
+    mbuf_cache_stat(pool, cache, num);
+
+    /*
+     * don't use rte_mempool_avail_count, it traverse cpu local cache,
+     * when RTE_MAX_LCORE is too large, it's time-consuming.
+     * the reserve only guards the shared ring, so skip it when the local cache covers the request.
+     */
+    if (reserve && (cache == NULL || cache->len < num)) {
         if (rte_ring_count(pool->pool_data) < MBUFPOOL_RESERVE_NUM + num) {
             return -ENOMEM;
         }
     }
 
-    int32_t ret = rte_pktmbuf_alloc_bulk(pool, mbufs, num);
+    if (user_cache) {
+        ret = rte_mempool_generic_get(pool, (void **)mbufs, num, cache);
+        for (uint32_t i = 0; ret == 0 && i < num; i++) {
+            rte_pktmbuf_reset(mbufs[i]);
+        }
+    } else {
+        ret = rte_pktmbuf_alloc_bulk(pool, mbufs, num);
+    }
     if (ret != 0) {
         LSTACK_LOG(ERR, LSTACK, "rte_pktmbuf_alloc_bulk fail allocNum=%d, ret=%d, info:%s \n",
                    num, ret, rte_strerror(-ret));
@@ -443,9 +598,39 @@ static int eth_params_init(struct eth_params *eth_params, uint16_t port_id, uint
     return 0;
 }
 
+/* rx checksums the nic does not verify, but vdev_rx_poll verifies in software before lwip */
+uint64_t dpdk_sw_rx_cksum_ol(void)
+{
+    if (!get_global_cfg_params()->rx_sw_cksum || xdp_eth_enabled()) {
+        return 0;
+    }
+    return DPDK_RX_CKSUM_OL & ~get_protocol_stack_group()->rx_offload;
+}
+
+/* the nic classifies ipv4/ipv6 tcp/udp in mbuf->packet_type, so vdev_rx_poll need not parse headers */
+static bool dpdk_rx_ptype_hw(int port_id)
+{
+    uint32_t ptypes[RX_PTYPE_MAX];
+    bool ipv4 = false;
+    bool ipv6 = false;
+    bool tcp = false;
+    bool udp = false;
+
+    int num = rte_eth_dev_get_supported_ptypes(port_id, RTE_PTYPE_L3_MASK | RTE_PTYPE_L4_MASK,
+        ptypes, RX_PTYPE_MAX);
+    for (int i = 0; i < LWIP_MIN(num, RX_PTYPE_MAX); i++) {
+        ipv4 |= RTE_ETH_IS_IPV4_HDR(ptypes[i]) != 0;
+        ipv6 |= (ptypes[i] & RTE_PTYPE_L3_MASK) == RTE_PTYPE_L3_IPV6;
+        tcp |= (ptypes[i] & RTE_PTYPE_L4_MASK) == RTE_PTYPE_L4_TCP;
+        udp |= (ptypes[i] & RTE_PTYPE_L4_MASK) == RTE_PTYPE_L4_UDP;
+    }
+
+    return ipv4 && ipv6 && tcp && udp;
+}
+
 uint64_t get_eth_params_rx_ol(void)
 {
-    return get_protocol_stack_group()->rx_offload;
+    return get_protocol_stack_group()->rx_offload | dpdk_sw_rx_cksum_ol();
 }
 
 uint64_t get_eth_params_tx_ol(void)
@@ -492,6 +677,16 @@ static void rss_setup(const int port_id, const uint16_t nb_queues)
     if (ret < 0) {
         LSTACK_LOG(ERR, LSTACK, "cannot update rss reta at port %d: %s\n",
             port_id, rte_strerror(-ret));
+    } else if (get_global_cfg_params()->rss_rebalance_interval != 0) {
+        if (dev_info.reta_size <= RSS_REBALANCE_RETA_MAX && nb_queues > 1) {
+            for (i = 0; i < dev_info.reta_size; i++) {
+                g_reta_queue[i] = i % nb_queues;
+            }
+            g_rss_rebalance = true;
+        } else {
+            LSTACK_LOG(WARNING, LSTACK, "rss_rebalance disabled, reta_size %u queues %u\n",
+                dev_info.reta_size, nb_queues);
+        }
     }
 
     free(reta_conf);
@@ -559,6 +754,11 @@ int32_t dpdk_ethdev_init(int port_id)
         }
     }
 
+    /* supported ptypes depend on the rx burst function chosen at start */
+    stack_group->rx_ptype_hw = dpdk_rx_ptype_hw(port_id);
+    LSTACK_LOG(INFO, LSTACK, "port %d rx packet type is parsed by %s\n", port_id,
+        stack_group->rx_ptype_hw ? "nic" : "software");
+
     /* after rte_eth_dev_configure */
     if ((get_global_cfg_params()->vlan_mode != -1) &&
         ((stack_group->rx_offload & RTE_ETH_RX_OFFLOAD_VLAN_FILTER) == RTE_ETH_RX_OFFLOAD_VLAN_FILTER)) {
@@ -839,19 +1039,9 @@ int init_dpdk_ethdev(void)
     return 0;
 }
 
-bool port_in_stack_queue(gz_addr_t *src_ip, gz_addr_t *dst_ip, uint16_t src_port, uint16_t dst_port)
+/* reta bucket the nic puts a packet from src to dst in */
+uint32_t dpdk_reta_index(const gz_addr_t *src_ip, const gz_addr_t *dst_ip, uint16_t src_port, uint16_t dst_port)
 {
-    struct protocol_stack_group *stack_group = get_protocol_stack_group();
-
-    /* ltran mode */
-    if (stack_group->eth_params == NULL) {
-        return true;
-    }
-
-    if (stack_group->eth_params->reta_mask == 0 || stack_group->eth_params->nb_queues <= 1) {
-        return true;
-    }
-
     union rte_thash_tuple tuple;
     uint32_t hash = 0;
     if (IP_IS_V4_VAL(*src_ip)) {
@@ -871,12 +1061,213 @@ bool port_in_stack_queue(gz_addr_t *src_ip, gz_addr_t *dst_ip, uint16_t src_port
         hash = rte_softrss((uint32_t *)&tuple, RTE_THASH_V6_L4_LEN, g_default_rss_key);
     }
 
-    uint32_t reta_index = hash & stack_group->eth_params->reta_mask;
+    return hash & g_eth_params.reta_mask;
+}
+
+bool port_in_stack_queue(gz_addr_t *src_ip, gz_addr_t *dst_ip, uint16_t src_port, uint16_t dst_port)
+{
+    struct protocol_stack_group *stack_group = get_protocol_stack_group();
+
+    /* ltran mode */
+    if (stack_group->eth_params == NULL) {
+        return true;
+    }
+
+    if (stack_group->eth_params->reta_mask == 0 || stack_group->eth_params->nb_queues <= 1) {
+        return true;
+    }
+
+    uint32_t reta_index = dpdk_reta_index(src_ip, dst_ip, src_port, dst_port);
 
     struct protocol_stack *stack = get_protocol_stack();
+    if (g_rss_rebalance) {
+        return __atomic_load_n(&g_reta_queue[reta_index], __ATOMIC_ACQUIRE) == stack->queue_id;
+    }
     return (reta_index % stack_group->eth_params->nb_queues) == stack->queue_id;
 }
 
+void dpdk_rss_reta_account(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t num)
+{
+    if (!g_rss_rebalance) {
+        return;
+    }
+
+    /* only tcp load is balanced, udp is just noted so its buckets can be pinned */
+    uint32_t *reta_pkts = g_reta_pkts[stack->stack_idx];
+    uint32_t *reta_udp = g_reta_udp[stack->stack_idx];
+    for (uint32_t i = 0; i < num; i++) {
+        if ((pkts[i]->ol_flags & RTE_MBUF_F_RX_RSS_HASH) == 0) {
+            continue;
+        }
+        uint32_t l4_type = pkts[i]->packet_type & RTE_PTYPE_L4_MASK;
+        if (l4_type == RTE_PTYPE_L4_TCP) {
+            reta_pkts[pkts[i]->hash.rss & g_eth_params.reta_mask]++;
+        } else if (l4_type == RTE_PTYPE_L4_UDP) {
+            reta_udp[pkts[i]->hash.rss & g_eth_params.reta_mask]++;
+        }
+    }
+}
+
+/*
+ * move the busiest reta buckets of the hottest queue to the coolest queue.
+ * a bucket holding a tcp connection or connected udp socket of any stack is never moved, its packets
+ * would reach a stack without the pcb. neither is a bucket that got udp while a udp socket is bound,
+ * the datagrams belong to the one stack owning that socket. buckets whose traffic is only new or short
+ * tcp connections move freely.
+ */
+static void dpdk_rss_rebalance_round(void)
+{
+    static uint32_t last_pkts[PROTOCOL_STACK_MAX][RSS_REBALANCE_RETA_MAX];
+    static uint32_t last_udp[PROTOCOL_STACK_MAX][RSS_REBALANCE_RETA_MAX];
+    static uint8_t conn_buckets[RSS_REBALANCE_RETA_MAX];
+    uint8_t udp_buckets[RSS_REBALANCE_RETA_MAX] = {0};
+    bool udp_bound = false;
+    uint64_t bucket_pkts[RSS_REBALANCE_RETA_MAX] = {0};
+    uint64_t queue_pkts[PROTOCOL_STACK_MAX] = {0};
+    struct rte_eth_rss_reta_entry64 reta_conf[RSS_REBALANCE_RETA_MAX / RTE_ETH_RETA_GROUP_SIZE];
+    uint16_t moved[RSS_REBALANCE_MOVE_MAX];
+    struct protocol_stack_group *stack_group = get_protocol_stack_group();
+    uint32_t reta_size = g_eth_params.reta_mask + 1;
+    uint16_t nb_queues = g_eth_params.nb_queues;
+    uint16_t hot = 0;
+    uint16_t cool = 0;
+    uint32_t move_num = 0;
+
+    for (uint16_t s = 0; s < stack_group->stack_num; s++) {
+        for (uint32_t b = 0; b < reta_size; b++) {
+            uint32_t cnt = __atomic_load_n(&g_reta_pkts[s][b], __ATOMIC_RELAXED);
+            bucket_pkts[b] += cnt - last_pkts[s][b];
+            last_pkts[s][b] = cnt;
+
+            cnt = __atomic_load_n(&g_reta_udp[s][b], __ATOMIC_RELAXED);
+            udp_buckets[b] |= (cnt != last_udp[s][b]);
+            last_udp[s][b] = cnt;
+        }
+    }
+    for (uint32_t b = 0; b < reta_size; b++) {
+        queue_pkts[g_reta_queue[b]] += bucket_pkts[b];
+    }
+    for (uint16_t q = 1; q < nb_queues; q++) {
+        hot = (queue_pkts[q] > queue_pkts[hot]) ? q : hot;
+        cool = (queue_pkts[q] < queue_pkts[cool]) ? q : cool;
+    }
+    if (queue_pkts[hot] - queue_pkts[cool] <= queue_pkts[hot] / RSS_REBALANCE_IMBALANCE) {
+        return;
+    }
+
+    (void)memset_s(conn_buckets, sizeof(conn_buckets), 0, sizeof(conn_buckets));
+    for (uint16_t s = 0; s < stack_group->stack_num; s++) {
+        /* a stopped stack never answers a sync rpc */
+        if (__atomic_load_n(&g_rss_rebalance_stop, __ATOMIC_ACQUIRE) ||
+            stack_get_state(stack_group->stacks[s]) != RUNNING) {
+            return;
+        }
+        if (rpc_call_reta_conn(&stack_group->stacks[s]->rpc_queue, conn_buckets, &udp_bound) < 0) {
+            return;
+        }
+    }
+    for (uint32_t b = 0; udp_bound && b < reta_size; b++) {
+        conn_buckets[b] |= udp_buckets[b];
+    }
+
+    (void)memset_s(reta_conf, sizeof(reta_conf), 0, sizeof(reta_conf));
+    /* move half of the gap at most, so the two queues do not swap roles */
+    uint64_t budget = (queue_pkts[hot] - queue_pkts[cool]) / 2;
+    while (move_num < RSS_REBALANCE_MOVE_MAX) {
+        uint32_t best = reta_size;
+        for (uint32_t b = 0; b < reta_size; b++) {
+            if (g_reta_queue[b] != hot || conn_buckets[b] || bucket_pkts[b] == 0 || bucket_pkts[b] > budget) {
+                continue;
+            }
+            if (best == reta_size || bucket_pkts[b] > bucket_pkts[best]) {
+                best = b;
+            }
+        }
+        if (best == reta_size) {
+            break;
+        }
+
+        reta_conf[best / RTE_ETH_RETA_GROUP_SIZE].mask |= 1ULL << (best % RTE_ETH_RETA_GROUP_SIZE);
+        reta_conf[best / RTE_ETH_RETA_GROUP_SIZE].reta[best % RTE_ETH_RETA_GROUP_SIZE] = cool;
+        budget -= bucket_pkts[best];
+        conn_buckets[best] = 1;
+        moved[move_num++] = best;
+    }
+    if (move_num == 0) {
+        return;
+    }
+
+    int ret = rte_eth_dev_rss_reta_update(g_eth_params.port_id, reta_conf, reta_size);
+    if (ret < 0) {
+        LSTACK_LOG(ERR, LSTACK, "rss_rebalance update reta failed: %s\n", rte_strerror(-ret));
+        return;
+    }
+    for (uint32_t i = 0; i < move_num; i++) {
+        __atomic_store_n(&g_reta_queue[moved[i]], cool, __ATOMIC_RELEASE);
+    }
+    LSTACK_LOG(INFO, LSTACK, "rss_rebalance moved %u buckets from queue %hu(%"PRIu64" pkts) to queue %hu(%"PRIu64
+        " pkts)\n", move_num, hot, queue_pkts[hot], cool, queue_pkts[cool]);
+}
+
+static void *dpdk_rss_rebalance_thread(void *arg)
+{
+    uint32_t interval = get_global_cfg_params()->rss_rebalance_interval;
+
+    while (!__atomic_load_n(&g_rss_rebalance_stop, __ATOMIC_ACQUIRE)) {
+        /* sleep in 1s slices, so a stop is seen quickly */
+        for (uint32_t i = 0; i < interval && !__atomic_load_n(&g_rss_rebalance_stop, __ATOMIC_ACQUIRE); i++) {
+            sleep(1);
+        }
+        if (__atomic_load_n(&g_rss_rebalance_stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        dpdk_rss_rebalance_round();
+    }
+    return NULL;
+}
+
+int32_t dpdk_rss_rebalance_start(void)
+{
+    pthread_t tid;
+
+    if (!g_rss_rebalance) {
+        return 0;
+    }
+
+    int ret = pthread_create(&tid, NULL, dpdk_rss_rebalance_thread, NULL);
+    if (ret != 0) {
+        LSTACK_LOG(ERR, LSTACK, "pthread_create ret=%d\n", ret);
+        g_rss_rebalance = false;
+        return -1;
+    }
+    pthread_setname_np(tid, "gazellerss");
+    g_rss_rebalance_tid = tid;
+    g_rss_rebalance_running = true;
+    return 0;
+}
+
+/* before stacks exit, so no round waits on a stack that is gone */
+void dpdk_rss_rebalance_stop(void)
+{
+    struct timespec ts;
+
+    if (!g_rss_rebalance_running) {
+        return;
+    }
+    __atomic_store_n(&g_rss_rebalance_stop, true, __ATOMIC_RELEASE);
+    if (pthread_equal(pthread_self(), g_rss_rebalance_tid)) {
+        return;
+    }
+
+    (void)clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += RSS_REBALANCE_STOP_WAIT_S;
+    if (pthread_timedjoin_np(g_rss_rebalance_tid, NULL, &ts) != 0) {
+        LSTACK_LOG(WARNING, LSTACK, "rss_rebalance thread did not stop in %ds\n", RSS_REBALANCE_STOP_WAIT_S);
+        return;
+    }
+    g_rss_rebalance_running = false;
+}
+
 static int dpdk_nic_xstats_value_get(uint64_t *values, unsigned int len, uint16_t *ports, unsigned int count)
 {
     uint64_t tmp_values[RTE_ETH_XSTATS_MAX_LEN];
@@ -1008,6 +1399,57 @@ void dpdk_nic_features_get(struct gazelle_stack_dfx_data *dfx, uint16_t port_id)
     return;
 }
 
+static struct numa_mem_stats *numa_mem_stats_node(struct gazelle_stat_lstack_mem *mem, int32_t numa_id)
+{
+    for (uint32_t i = 0; i < mem->node_num; i++) {
+        if (mem->node[i].numa_id == numa_id) {
+            return &mem->node[i];
+        }
+    }
+    if (mem->node_num >= NUMA_MEM_STAT_MAX) {
+        return NULL;
+    }
+    mem->node[mem->node_num].numa_id = numa_id;
+    return &mem->node[mem->node_num++];
+}
+
+static void numa_mem_stats_mempool(struct rte_mempool *mp, void *arg)
+{
+    struct numa_mem_stats *node = numa_mem_stats_node(arg, mp->socket_id);
+    if (node == NULL) {
+        return;
+    }
+    node->mempool_num++;
+    node->mempool_bytes += (uint64_t)mp->size * (mp->header_size + mp->elt_size + mp->trailer_size);
+}
+
+void dpdk_numa_mem_get(struct gazelle_stack_dfx_data *dfx)
+{
+    struct gazelle_stat_lstack_mem *mem = &dfx->data.mem_stats;
+    struct protocol_stack_group *stack_group = get_protocol_stack_group();
+    struct rte_malloc_socket_stats heap_stats;
+    struct numa_mem_stats *node;
+
+    for (uint32_t i = 0; i < rte_socket_count(); i++) {
+        int32_t numa_id = rte_socket_id_by_idx(i);
+        node = numa_mem_stats_node(mem, numa_id);
+        if (node == NULL || rte_malloc_get_socket_stats(numa_id, &heap_stats) != 0) {
+            continue;
+        }
+        node->heap_total = heap_stats.heap_totalsz_bytes;
+        node->heap_alloc = heap_stats.heap_allocsz_bytes;
+    }
+
+    for (uint32_t i = 0; i < stack_group->stack_num; i++) {
+        node = numa_mem_stats_node(mem, stack_group->stacks[i]->numa_id);
+        if (node != NULL) {
+            node->stack_num++;
+        }
+    }
+
+    rte_mempool_walk(numa_mem_stats_mempool, mem);
+}
+
 uint32_t dpdk_pktmbuf_mempool_num(void)
 {
     struct cfg_params *cfg = get_global_cfg_params();
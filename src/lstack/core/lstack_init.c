@@ -47,6 +47,7 @@
 #include "lstack_wrap.h"
 #include "lstack_flow.h"
 #include "lstack_interrupt.h"
+#include "lstack_virtio.h"
 
 static void check_process_start(void)
 {
@@ -121,6 +122,8 @@ static int set_rlimit_unlimited(void)
 
 void gazelle_exit(void)
 {
+    dpdk_rss_rebalance_stop();
+    virtio_exception_thread_stop();
     wrap_api_exit();
     stack_group_exit();
 }
@@ -259,6 +262,17 @@ __attribute__((constructor)) void gazelle_network_init(void)
         LSTACK_PRE_LOG(LSTACK_WARNING, "set rlimit unlimited failed. errno=%d\n", errno);
     }
 
+    /* pre-fork master stays in kernel, first forked child starts lstack in lstack_fork */
+    if (get_global_cfg_params()->fork_defer_init) {
+        LSTACK_PRE_LOG(LSTACK_INFO, "fork_defer_init: lstack starts in first forked child\n");
+        return;
+    }
+
+    gazelle_network_start();
+}
+
+void gazelle_network_start(void)
+{
     /* check primary process start */
     check_process_start();
 
@@ -323,6 +337,11 @@ __attribute__((constructor)) void gazelle_network_init(void)
             gazelle_exit();
             LSTACK_EXIT(1, "stack_setup_thread failed\n");
         }
+
+        /* rebalance queries every stack over rpc, start it once they all run */
+        if (dpdk_rss_rebalance_start() != 0) {
+            LSTACK_LOG(ERR, LSTACK, "rss_rebalance thread start failed, reta stays static\n");
+        }
     }
 
 #if RTE_VERSION < RTE_VERSION_NUM(23, 11, 0, 0)
@@ -16,6 +16,7 @@
 
 #include <rte_errno.h>
 #include <rte_malloc.h>
+#include <rte_mempool.h>
 
 #include <lwip/sockets.h>
 #include <lwip/tcp.h>
@@ -39,6 +40,11 @@
 
 static const uint8_t fin_packet = 0;
 
+/* UDP_SEGMENT size of each udp socket, 0 means the send buffer is one datagram */
+static uint16_t g_udp_gso_size[GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS];
+/* conn_compact: idle mbufs the stack keeps in a tcp socket's send_ring, 0 means the seed count */
+static uint32_t g_send_refill[GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS];
+
 static void free_ring_pbuf(struct rte_ring *ring)
 {
     void *pbufs[SOCK_RECV_RING_SIZE];
@@ -137,12 +143,12 @@ static uint32_t update_replenish_mbuf_cnt(struct protocol_stack *stack, struct l
 }
 
 /* true: need replenish again */
-static bool replenish_send_idlembuf(struct protocol_stack *stack, struct lwip_sock *sock)
+static bool replenish_send_idlembuf(struct protocol_stack *stack, struct lwip_sock *sock, uint32_t max_cnt)
 {
     void *pbuf[SOCK_SEND_RING_SIZE_MAX];
     struct rte_ring *ring = sock->send_ring;
 
-    uint32_t replenish_cnt = update_replenish_mbuf_cnt(stack, sock);
+    uint32_t replenish_cnt = LWIP_MIN(update_replenish_mbuf_cnt(stack, sock), max_cnt);
     if (replenish_cnt == 0) {
         return false;
     }
@@ -168,6 +174,51 @@ static bool replenish_send_idlembuf(struct protocol_stack *stack, struct lwip_so
     return false;
 }
 
+/*
+ * conn_compact: a tcp socket starts with just enough idle mbufs to pass the blocking write threshold
+ * (a quarter of send_ring), the rest is replenished by the stack as the socket actually sends.
+ * udp keeps the full fill, one datagram may need the whole ring.
+ */
+static inline uint32_t sock_send_seed_cnt(struct lwip_sock *sock)
+{
+    if (!get_global_cfg_params()->conn_compact || NETCONN_IS_UDP(sock)) {
+        return SOCK_SEND_RING_SIZE_MAX;
+    }
+    return (rte_ring_get_capacity(sock->send_ring) >> 2) + 1;
+}
+
+/*
+ * conn_compact: refill up to a per-socket target. the target doubles toward the ring capacity when the app
+ * drained every idle mbuf since the last refill, and halves back toward the seed when it used none of them.
+ */
+static inline uint32_t sock_send_replenish_cnt(struct lwip_sock *sock)
+{
+    int32_t fd = sock->conn->callback_arg.socket;
+    uint32_t capacity;
+    uint32_t target;
+    uint32_t seed;
+    uint32_t idle;
+
+    if (!get_global_cfg_params()->conn_compact || NETCONN_IS_UDP(sock)) {
+        return SOCK_SEND_RING_SIZE_MAX;
+    }
+    seed = sock_send_seed_cnt(sock);
+    idle = gazelle_ring_readable_count(sock->send_ring);
+    if (fd < 0 || fd >= GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS) {
+        return (idle < seed) ? seed - idle : 0;
+    }
+
+    capacity = rte_ring_get_capacity(sock->send_ring);
+    target = (g_send_refill[fd] == 0) ? seed : g_send_refill[fd];
+    if (idle == 0) {
+        target = LWIP_MIN(target << 1, capacity);
+    } else if (idle >= target) {
+        target = LWIP_MAX(target >> 1, seed);
+    }
+    g_send_refill[fd] = target;
+    return (idle < target) ? target - idle : 0;
+}
+
 int do_lwip_init_sock(int32_t fd)
 {
     struct protocol_stack *stack = get_protocol_stack();
@@ -176,6 +227,11 @@ int do_lwip_init_sock(int32_t fd)
         return -1;
     }
 
+    if (fd >= 0 && fd < GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS) {
+        g_udp_gso_size[fd] = 0;
+        g_send_refill[fd] = 0;
+    }
+
     if (get_global_cfg_params()->stack_mode_rtc) {
         sock->stack = stack;
         sock->epoll_events = 0;
@@ -205,7 +261,7 @@ int do_lwip_init_sock(int32_t fd)
         LSTACK_LOG(ERR, LSTACK, "sock_send create failed. errno: %d.\n", rte_errno);
         return -1;
     }
-    (void)replenish_send_idlembuf(stack, sock);
+    (void)replenish_send_idlembuf(stack, sock, sock_send_seed_cnt(sock));
 
     sock->stack = stack;
 
@@ -221,7 +277,7 @@ void do_lwip_clean_sock(int fd)
         return;
     }
 
-    if (sock->wakeup && sock->wakeup->type == WAKEUP_EPOLL) {
+    if (sock->wakeup && (sock->wakeup->type == WAKEUP_EPOLL || sock->wakeup->type == WAKEUP_POLL)) {
         pthread_spin_lock(&sock->wakeup->event_list_lock);
         list_del_node(&sock->event_list);
         pthread_spin_unlock(&sock->wakeup->event_list_lock);
@@ -230,8 +286,68 @@ void do_lwip_clean_sock(int fd)
     sock->stack->conn_num--;
 
     reset_sock_data(sock);
+    /* the fd may be reused with another epoll, whose epoll_ctl takes the node back */
+    release_sock_event_node(fd);
 
     list_del_node(&sock->recv_list);
+
+    if (fd >= 0 && fd < GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS) {
+        g_udp_gso_size[fd] = 0;
+        g_send_refill[fd] = 0;
+    }
+}
+
+static struct lwip_sock *udp_gso_sock(int fd)
+{
+    if (fd < 0 || fd >= GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS) {
+        return NULL;
+    }
+
+    struct lwip_sock *sock = lwip_get_socket(fd);
+    if (sock == NULL || sock->conn == NULL || !NETCONN_IS_UDP(sock)) {
+        return NULL;
+    }
+    return sock;
+}
+
+int do_lwip_set_udp_gso(int fd, const void *optval, socklen_t optlen)
+{
+    if (optval == NULL || optlen < sizeof(int)) {
+        GAZELLE_RETURN(EINVAL);
+    }
+    if (udp_gso_sock(fd) == NULL) {
+        GAZELLE_RETURN(ENOPROTOOPT);
+    }
+
+    int val = *(const int *)optval;
+    if (val < 0 || val > GAZELLE_UDP_PKGLEN_MAX) {
+        GAZELLE_RETURN(EINVAL);
+    }
+
+    g_udp_gso_size[fd] = (uint16_t)val;
+    return 0;
+}
+
+int do_lwip_get_udp_gso(int fd, void *optval, socklen_t *optlen)
+{
+    if (optval == NULL || optlen == NULL || *optlen < sizeof(int)) {
+        GAZELLE_RETURN(EINVAL);
+    }
+    if (udp_gso_sock(fd) == NULL) {
+        GAZELLE_RETURN(ENOPROTOOPT);
+    }
+
+    *(int *)optval = g_udp_gso_size[fd];
+    *optlen = sizeof(int);
+    return 0;
+}
+
+static inline uint16_t udp_gso_size(int fd)
+{
+    if (fd < 0 || fd >= GAZELLE_MAX_CLIENTS + GAZELLE_RESERVED_CLIENTS) {
+        return 0;
+    }
+    return g_udp_gso_size[fd];
 }
 
 void do_lwip_free_pbuf(struct pbuf *pbuf)
@@ -242,7 +358,7 @@ void do_lwip_free_pbuf(struct pbuf *pbuf)
 
     struct rte_mbuf *mbuf = pbuf_to_mbuf(pbuf);
 
-    rte_pktmbuf_free_seg(mbuf);
+    dpdk_free_pktmbuf_seg(mbuf);
 }
 
 struct pbuf *do_lwip_alloc_pbuf(pbuf_layer layer, uint16_t length, pbuf_type type)
@@ -499,7 +615,17 @@ int sem_timedwait_nsecs(sem_t *sem)
     return sem_timedwait(sem, &ts);
 }
 
-static ssize_t do_lwip_udp_fill_sendring(struct lwip_sock *sock, const void *buf, size_t len,
+static inline uint32_t udp_write_num(size_t len)
+{
+    /* if udp send 0 packet, set write_num to at least 1 */
+    if (len == 0) {
+        return 1;
+    }
+    return (len + MBUF_MAX_DATA_LEN - 1) / MBUF_MAX_DATA_LEN;
+}
+
+/* gso_size > 0: split buf into gso_size datagrams, only the last one may be shorter */
+static ssize_t do_lwip_udp_fill_sendring(struct lwip_sock *sock, const void *buf, size_t len, uint16_t gso_size,
                                          const struct sockaddr *addr, socklen_t addrlen)
 {
     if (len > GAZELLE_UDP_PKGLEN_MAX) {
@@ -508,7 +634,12 @@ static ssize_t do_lwip_udp_fill_sendring(struct lwip_sock *sock, const void *buf
     }
 
     ssize_t send_len = 0;
-    uint32_t write_num = (len + MBUF_MAX_DATA_LEN - 1) / MBUF_MAX_DATA_LEN;
+    size_t seg_len = (gso_size == 0 || len <= gso_size) ? len : gso_size;
+    uint32_t seg_num = (seg_len == 0) ? 1 : (len + seg_len - 1) / seg_len;
+    size_t last_len = len - (seg_num - 1) * seg_len;
+    uint32_t seg_write = udp_write_num(seg_len);
+    uint32_t last_write = udp_write_num(last_len);
+    uint32_t write_num = (seg_num - 1) * seg_write + last_write;
     uint32_t write_avail = gazelle_ring_readable_count(sock->send_ring);
     struct wakeup_poll *wakeup = sock->wakeup;
 
@@ -517,11 +648,6 @@ static ssize_t do_lwip_udp_fill_sendring(struct lwip_sock *sock, const void *buf
         GAZELLE_RETURN(ENOMEM);
     }
 
-    /* if udp send 0 packet, set write_num to at least 1 */
-    if (write_num == 0) {
-        write_num = 1;
-    }
-
     while (!netconn_is_nonblocking(sock->conn) && (write_avail < write_num)) {
         if (sock->errevent > 0) {
             GAZELLE_RETURN(ENOTCONN);
@@ -535,7 +661,11 @@ static ssize_t do_lwip_udp_fill_sendring(struct lwip_sock *sock, const void *buf
         GAZELLE_RETURN(ENOMEM);
     }
 
-    send_len = app_buff_write(sock, (char *)buf, len, write_num, addr, addrlen);
+    /* all segments are written at once, the stack sends them in one rpc */
+    for (uint32_t i = 0; i < seg_num - 1; i++) {
+        send_len += app_buff_write(sock, (char *)buf + send_len, seg_len, seg_write, addr, addrlen);
+    }
+    send_len += app_buff_write(sock, (char *)buf + send_len, last_len, last_write, addr, addrlen);
 
     if (wakeup && wakeup->type == WAKEUP_EPOLL && (sock->events & EPOLLOUT)
         && !NETCONN_IS_OUTIDLE(sock)) {
@@ -642,7 +772,7 @@ bool do_lwip_replenish_sendring(struct protocol_stack *stack, struct lwip_sock *
 {
     bool replenish_again = false;
 
-    replenish_again = replenish_send_idlembuf(stack, sock);
+    replenish_again = replenish_send_idlembuf(stack, sock, sock_send_replenish_cnt(sock));
 
     if (NETCONN_IS_OUTIDLE(sock)) {
         add_sock_event(sock, EPOLLOUT);
@@ -797,10 +927,11 @@ static inline void notice_stack_tcp_send(struct lwip_sock *sock, int32_t fd, int
     }
 }
 
-static inline void notice_stack_udp_send(struct lwip_sock *sock, int32_t fd, int32_t len, int32_t flags)
+static inline void notice_stack_udp_send(struct lwip_sock *sock, int32_t fd, int32_t len, int32_t flags,
+                                         uint16_t gso_size)
 {
     __sync_fetch_and_add(&sock->call_num, 1);
-    while (rpc_call_udp_send(&sock->stack->rpc_queue, fd, len, flags) < 0) {
+    while (rpc_call_udp_send(&sock->stack->rpc_queue, fd, len, flags, gso_size) < 0) {
         usleep(1000); // 1000: wait 1ms to exec again
     }
 }
@@ -808,7 +939,7 @@ static inline void notice_stack_udp_send(struct lwip_sock *sock, int32_t fd, int
 static inline void notice_stack_send(struct lwip_sock *sock, int32_t fd, int32_t len, int32_t flags)
 {
     if (NETCONN_IS_UDP(sock)) {
-        notice_stack_udp_send(sock, fd, len, flags);
+        notice_stack_udp_send(sock, fd, len, flags, 0);
     } else {
         notice_stack_tcp_send(sock, fd, len, flags);
     }
@@ -911,11 +1042,14 @@ ssize_t do_lwip_send_to_stack(int32_t fd, const void *buf, size_t len, int32_t f
     }
 
     if (NETCONN_IS_UDP(sock)) {
-        send = do_lwip_udp_fill_sendring(sock, buf, len, addr, addrlen);
+        uint16_t gso_size = udp_gso_size(fd);
+        send = do_lwip_udp_fill_sendring(sock, buf, len, gso_size, addr, addrlen);
         /* send = 0: udp send a empty package */
         if (send < 0) {
             return send;
         }
+        notice_stack_udp_send(sock, fd, send, flags, gso_size);
+        return send;
     } else {
         send = do_lwip_tcp_fill_sendring(sock, buf, len, addr, addrlen);
         // send = 0 : tcp peer close connection ?
@@ -933,6 +1067,7 @@ ssize_t do_lwip_sendmsg_to_stack(struct lwip_sock *sock, int32_t s, const struct
     int32_t ret;
     int32_t i;
     ssize_t buflen = 0;
+    uint16_t gso_size = NETCONN_IS_UDP(sock) ? udp_gso_size(s) : 0;
 
     if (check_msg_vaild(message)) {
         GAZELLE_RETURN(EINVAL);
@@ -944,7 +1079,12 @@ ssize_t do_lwip_sendmsg_to_stack(struct lwip_sock *sock, int32_t s, const struct
         }
 
         if (NETCONN_IS_UDP(sock)) {
-            ret = do_lwip_udp_fill_sendring(sock, message->msg_iov[i].iov_base, message->msg_iov[i].iov_len, NULL, 0);
+            ret = do_lwip_udp_fill_sendring(sock, message->msg_iov[i].iov_base, message->msg_iov[i].iov_len, gso_size,
+                                            NULL, 0);
+            /* each iov is segmented on its own, its segment boundaries go with its own rpc */
+            if (ret > 0 && gso_size != 0) {
+                notice_stack_udp_send(sock, s, ret, flags, gso_size);
+            }
         } else {
             ret = do_lwip_tcp_fill_sendring(sock, message->msg_iov[i].iov_base, message->msg_iov[i].iov_len, NULL, 0);
         }
@@ -960,7 +1100,7 @@ ssize_t do_lwip_sendmsg_to_stack(struct lwip_sock *sock, int32_t s, const struct
         }
     }
 
-    if (buflen > 0) {
+    if (buflen > 0 && gso_size == 0) {
         notice_stack_send(sock, s, buflen, flags);
     }
     return buflen;
@@ -1300,6 +1440,24 @@ void do_lwip_connected_callback(struct netconn *conn)
     add_sock_event(sock, EPOLLOUT);
 }
 
+/* bytes held by the gazelle side of a socket: its rings and the mbufs parked in them */
+static uint32_t sock_mem_size(const struct lwip_sock *sock, uint32_t mbuf_cnt)
+{
+    uint32_t size = 0;
+
+    if (sock->recv_ring != NULL) {
+        size += rte_ring_get_memsize(rte_ring_get_size(sock->recv_ring));
+    }
+    if (sock->send_ring != NULL) {
+        size += rte_ring_get_memsize(rte_ring_get_size(sock->send_ring));
+    }
+    if (sock->stack != NULL && sock->stack->rxtx_mbuf_pool != NULL) {
+        size += mbuf_cnt * (sock->stack->rxtx_mbuf_pool->header_size +
+            sock->stack->rxtx_mbuf_pool->elt_size + sock->stack->rxtx_mbuf_pool->trailer_size);
+    }
+    return size;
+}
+
 static void copy_pcb_to_conn(struct gazelle_stat_lstack_conn_info *conn, const struct tcp_pcb *pcb)
 {
     struct netconn *netconn = (struct netconn *)pcb->callback_arg;
@@ -1331,6 +1489,8 @@ static void copy_pcb_to_conn(struct gazelle_stat_lstack_conn_info *conn, const s
             conn->recv_ring_cnt = (sock->recv_ring == NULL) ? 0 : gazelle_ring_readable_count(sock->recv_ring);
             conn->recv_ring_cnt += (sock->recv_lastdata) ? 1 : 0;
             conn->send_ring_cnt = (sock->send_ring == NULL) ? 0 : gazelle_ring_readover_count(sock->send_ring);
+            conn->send_ring_idle = (sock->send_ring == NULL) ? 0 : gazelle_ring_readable_count(sock->send_ring);
+            conn->sock_mem = sock_mem_size(sock, conn->recv_ring_cnt + conn->send_ring_cnt + conn->send_ring_idle);
             conn->events = sock->events;
             conn->epoll_events = sock->epoll_events;
             conn->eventlist = !list_node_null(&sock->event_list);
@@ -1396,6 +1556,42 @@ uint32_t do_lwip_get_conntable(struct gazelle_stat_lstack_conn_info *conn,
     return conn_num;
 }
 
+/*
+ * mark the reta buckets the nic steers this stack's tcp connections and connected udp sockets by.
+ * a udp socket that is only bound takes datagrams from any peer, its buckets are unknown, so it is
+ * reported through udp_bound and the caller pins every bucket that carries udp.
+ */
+uint32_t do_lwip_mark_reta_conn(uint8_t *buckets, bool *udp_bound)
+{
+    struct tcp_pcb *pcb = NULL;
+    struct udp_pcb *upcb = NULL;
+    uint32_t conn_num = 0;
+
+    for (pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next) {
+        buckets[dpdk_reta_index((gz_addr_t *)&pcb->remote_ip, (gz_addr_t *)&pcb->local_ip,
+            pcb->remote_port, pcb->local_port)] = 1;
+        conn_num++;
+    }
+
+    for (pcb = tcp_tw_pcbs; pcb != NULL; pcb = pcb->next) {
+        buckets[dpdk_reta_index((gz_addr_t *)&pcb->remote_ip, (gz_addr_t *)&pcb->local_ip,
+            pcb->remote_port, pcb->local_port)] = 1;
+        conn_num++;
+    }
+
+    for (upcb = udp_pcbs; upcb != NULL; upcb = upcb->next) {
+        if ((upcb->flags & UDP_FLAGS_CONNECTED) == 0) {
+            *udp_bound = true;
+            continue;
+        }
+        buckets[dpdk_reta_index((gz_addr_t *)&upcb->remote_ip, (gz_addr_t *)&upcb->local_ip,
+            upcb->remote_port, upcb->local_port)] = 1;
+        conn_num++;
+    }
+
+    return conn_num;
+}
+
 uint32_t do_lwip_get_connnum(void)
 {
     struct tcp_pcb *pcb = NULL;
@@ -1417,6 +1613,45 @@ uint32_t do_lwip_get_connnum(void)
     return conn_num;
 }
 
+/* a syn is dropped before lwip gives it a pcb when its listener's accept queue
+ * or the rxtx mbuf pool of the stack is used above syn_watermark percent */
+bool do_lwip_syn_overload(struct protocol_stack *stack, const gz_addr_t *local_ip, uint16_t port)
+{
+    uint64_t watermark = get_global_cfg_params()->syn_watermark;
+    struct rte_mempool *pool = stack->rxtx_mbuf_pool;
+    struct tcp_pcb_listen *match = NULL;
+
+    /* mbuf_in_use counts free mbufs parked in lcore and private caches as free, see stack_polling */
+    if ((uint64_t)stack->mbuf_in_use * 100 >= pool->size * watermark) {
+        return true;
+    }
+
+    /* same choice as tcp_input: an exact local_ip listener wins over an any-address one */
+    for (struct tcp_pcb_listen *pcbl = tcp_listen_pcbs.listen_pcbs; pcbl != NULL; pcbl = pcbl->next) {
+        if (pcbl->local_port != port) {
+            continue;
+        }
+        if (ip_addr_cmp(&pcbl->local_ip, (const ip_addr_t *)local_ip)) {
+            match = pcbl;
+            break;
+        }
+        if (match == NULL && IP_ADDR_PCB_VERSION_MATCH(pcbl, (const ip_addr_t *)local_ip) &&
+            ip_addr_isany(&pcbl->local_ip)) {
+            match = pcbl;
+        }
+    }
+    if (match == NULL) {
+        return false;
+    }
+
+    struct netconn *netconn = (struct netconn *)match->callback_arg;
+    if (netconn == NULL || netconn->acceptmbox == NULL) {
+        return false;
+    }
+    struct rte_ring *ring = netconn->acceptmbox->ring;
+    return (uint64_t)rte_ring_count(ring) * 100 >= rte_ring_get_capacity(ring) * watermark;
+}
+
 void netif_poll(struct netif *netif)
 {
     struct tcp_pcb *pcb = NULL;
@@ -1553,7 +1788,7 @@ err_t same_node_memzone_create(const struct rte_memzone **zone, int size, int po
     char mem_name[RING_NAME_LEN] = {0};
     snprintf_s(mem_name, sizeof(mem_name), sizeof(mem_name) - 1, "%s_%s_%d", name, rx, port);
 
-    *zone = rte_memzone_reserve_aligned(mem_name, size, rte_socket_id(), 0, RTE_CACHE_LINE_SIZE);
+    *zone = rte_memzone_reserve_aligned(mem_name, size, dpdk_thread_numa_id(), 0, RTE_CACHE_LINE_SIZE);
     if (*zone == NULL) {
         LSTACK_LOG(ERR, LSTACK, "cannot reserve memzone:%s, errno is %d\n", mem_name, rte_errno);
         return ERR_MEM;
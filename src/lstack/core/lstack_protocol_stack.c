@@ -15,6 +15,8 @@
 #include <securec.h>
 #include <numa.h>
 
+#include <rte_cycles.h>
+
 #include <lwip/sockets.h>
 #include <lwip/init.h>
 #include <lwip/tcp.h>
@@ -32,6 +34,7 @@
 #include "lstack_epoll.h"
 #include "lstack_stack_stat.h"
 #include "lstack_virtio.h"
+#include "lstack_vdev.h"
 #include "lstack_interrupt.h"
 #include "lstack_protocol_stack.h"
 
@@ -43,6 +46,10 @@
 
 static PER_THREAD struct protocol_stack *g_stack_p = NULL;
 static struct protocol_stack_group g_stack_group = {0};
+/* listen_reuseport: bitmap of stacks holding a listener, indexed by host order tcp port */
+static uint32_t g_reuseport_stacks[UINT16_MAX + 1] = {0};
+/* stacks that closed a listener on the port, their accepted flows may still be alive */
+static uint32_t g_reuseport_left[UINT16_MAX + 1] = {0};
 
 typedef void *(*stack_thread_func)(void *arg);
 
@@ -111,7 +118,6 @@ struct protocol_stack *get_bind_protocol_stack(void)
 
     struct protocol_stack_group *stack_group = get_protocol_stack_group();
     uint16_t index = 0;
-    int min_conn_num = GAZELLE_MAX_CLIENTS;
 
     /* close listen shadow, per app communication thread select only one stack */
     if (!get_global_cfg_params()->tuple_filter && !get_global_cfg_params()->listen_shadow) {
@@ -123,13 +129,7 @@ struct protocol_stack *get_bind_protocol_stack(void)
         }
     } else {
         pthread_spin_lock(&stack_group->socket_lock);
-        for (uint16_t i = 0; i < stack_group->stack_num; i++) {
-            struct protocol_stack* stack = stack_group->stacks[i];
-            if (stack->conn_num < min_conn_num) {
-                index = i;
-                min_conn_num = stack->conn_num;
-            }
-        }
+        index = get_min_conn_stack(stack_group);
     }
 
     stack_group->stacks[index]->conn_num++;
@@ -138,22 +138,123 @@ struct protocol_stack *get_bind_protocol_stack(void)
     return stack_group->stacks[index];
 }
 
+/* compare measured cpu usage, then rx rate, fall back to connection count when loads are close */
+bool stack_load_less(const struct protocol_stack *stack, const struct protocol_stack *other)
+{
+    if (get_global_cfg_params()->stack_rebalance) {
+        uint32_t usage = __atomic_load_n(&stack->load.cpu_usage, __ATOMIC_RELAXED);
+        uint32_t other_usage = __atomic_load_n(&other->load.cpu_usage, __ATOMIC_RELAXED);
+
+        if (usage + STACK_LOAD_TOLERANCE < other_usage) {
+            return true;
+        }
+        if (other_usage + STACK_LOAD_TOLERANCE < usage) {
+            return false;
+        }
+
+        /* idle polling hides load at low cpu usage, the packet rate still tells stacks apart */
+        uint32_t rate = __atomic_load_n(&stack->load.rx_rate, __ATOMIC_RELAXED);
+        uint32_t other_rate = __atomic_load_n(&other->load.rx_rate, __ATOMIC_RELAXED);
+
+        if (rate + (other_rate >> STACK_LOAD_RATE_SHIFT) < other_rate) {
+            return true;
+        }
+        if (other_rate + (rate >> STACK_LOAD_RATE_SHIFT) < rate) {
+            return false;
+        }
+    }
+
+    return stack->conn_num < other->conn_num;
+}
+
 int get_min_conn_stack(struct protocol_stack_group *stack_group)
 {
-    struct protocol_stack* stack;
     int min_conn_stk_idx = 0;
-    int min_conn_num = GAZELLE_MAX_CLIENTS;
 
-    for (int i = 0; i < stack_group->stack_num; i++) {
-        stack = stack_group->stacks[i];
-        if (stack->conn_num < min_conn_num) {
+    for (int i = 1; i < stack_group->stack_num; i++) {
+        if (stack_load_less(stack_group->stacks[i], stack_group->stacks[min_conn_stk_idx])) {
             min_conn_stk_idx = i;
-            min_conn_num = stack->conn_num;
         }
     }
     return min_conn_stk_idx;
 }
 
+void stack_reuseport_add(uint16_t port, uint32_t stack_idx)
+{
+    __atomic_fetch_or(&g_reuseport_stacks[port], 1U << stack_idx, __ATOMIC_RELEASE);
+}
+
+void stack_reuseport_del(uint16_t port, uint32_t stack_idx)
+{
+    __atomic_fetch_or(&g_reuseport_left[port], 1U << stack_idx, __ATOMIC_RELEASE);
+    __atomic_fetch_and(&g_reuseport_stacks[port], ~(1U << stack_idx), __ATOMIC_RELEASE);
+}
+
+bool stack_reuseport_left(uint16_t port, uint32_t stack_idx)
+{
+    return (__atomic_load_n(&g_reuseport_left[port], __ATOMIC_ACQUIRE) & (1U << stack_idx)) != 0;
+}
+
+/* return the stack that should take a new flow to port, -1 means keep it on current stack */
+int stack_reuseport_select(uint16_t port, uint32_t hash, uint32_t cur_idx)
+{
+    uint32_t mask = __atomic_load_n(&g_reuseport_stacks[port], __ATOMIC_ACQUIRE);
+    uint32_t nth;
+
+    if (mask == 0 || (mask & (1U << cur_idx)) != 0) {
+        return -1;
+    }
+
+    /* pick the nth listening stack. the mask changes with listen and close, callers record the choice per flow
+     * while their flow table has room */
+    nth = hash % (uint32_t)__builtin_popcount(mask);
+    while (nth-- > 0) {
+        mask &= mask - 1;
+    }
+    return __builtin_ctz(mask);
+}
+
+static void stack_load_update(struct protocol_stack *stack, uint32_t nr_pkts, uint64_t start_tsc)
+{
+    struct stack_load *load = &stack->load;
+    uint64_t now = rte_rdtsc();
+    uint64_t interval = now - load->last_tsc;
+
+    if (nr_pkts > 0) {
+        load->busy_tsc += now - start_tsc;
+    }
+
+    if (interval < rte_get_tsc_hz() / MS_PER_S * STACK_LOAD_INTERVAL_MS) {
+        return;
+    }
+
+    uint32_t usage = (load->busy_tsc - load->last_busy_tsc) * 100 / interval;
+    uint32_t rate = stack->stats.rx - load->last_rx_pkts;
+
+    /* ewma with weight 1/4, keep short bursts from flapping the placement */
+    __atomic_store_n(&load->cpu_usage, (load->cpu_usage * 3 + usage) >> 2, __ATOMIC_RELAXED);
+    __atomic_store_n(&load->rx_rate, (load->rx_rate * 3 + rate) >> 2, __ATOMIC_RELAXED);
+
+    load->last_tsc = now;
+    load->last_busy_tsc = load->busy_tsc;
+    load->last_rx_pkts = stack->stats.rx;
+}
+
+/* lwip timers walk every pcb of the stack, record the worst run so the stall is visible in gazellectl */
+static uint32_t stack_timer_run(struct protocol_stack *stack)
+{
+    static PER_THREAD uint64_t timer_max_tsc = 0;
+    uint64_t start = rte_rdtsc();
+    uint32_t timeout = sys_timer_run();
+    uint64_t cost = rte_rdtsc() - start;
+
+    if (unlikely(cost > timer_max_tsc)) {
+        timer_max_tsc = cost;
+        stack->stats.timer_run_max_us = cost * US_PER_S / rte_get_tsc_hz();
+    }
+    return timeout;
+}
+
 void bind_to_stack_numa(struct protocol_stack *stack)
 {
     int32_t ret;
@@ -390,6 +491,16 @@ static void* gazelle_kernelevent_thread(void *arg)
     return NULL;
 }
 
+static int stack_numa_of_idx(uint16_t idx)
+{
+    struct cfg_params *cfg_params = get_global_cfg_params();
+
+    if (cfg_params->stack_num > 0) {
+        return cfg_params->numa_id;
+    }
+    return numa_node_of_cpu(cfg_params->cpus[idx]);
+}
+
 static int32_t init_stack_value(struct protocol_stack *stack, void *arg)
 {
     struct thread_params *t_params = (struct thread_params*) arg;
@@ -415,15 +526,13 @@ static int32_t init_stack_value(struct protocol_stack *stack, void *arg)
         return -1;
     }
 
-    if (cfg_params->stack_num > 0) {
-        stack->numa_id = cfg_params->numa_id;
-    } else {
+    if (cfg_params->stack_num == 0) {
         stack->cpu_id = cfg_params->cpus[t_params->idx];
-        stack->numa_id = numa_node_of_cpu(stack->cpu_id);
-        if (stack->numa_id < 0) {
-            LSTACK_LOG(ERR, LSTACK, "numa_node_of_cpu failed\n");
-            return -1;
-        }
+    }
+    stack->numa_id = stack_numa_of_idx(t_params->idx);
+    if (stack->numa_id < 0) {
+        LSTACK_LOG(ERR, LSTACK, "numa_node_of_cpu failed\n");
+        return -1;
     }
 
     if (pktmbuf_pool_init(stack) != 0) {
@@ -464,6 +573,14 @@ static int32_t create_affiliate_thread(void *arg)
 
 static struct protocol_stack *stack_thread_init(void *arg)
 {
+    struct thread_params *t_params = (struct thread_params *)arg;
+    int numa_id = stack_numa_of_idx(t_params->idx);
+
+    /* run on the stack's node before anything is allocated, so the stack, its rings and rpc pool are node local */
+    if (numa_id >= 0) {
+        stack_affinity_numa(numa_id);
+    }
+
     struct protocol_stack *stack = calloc(1, sizeof(*stack));
     if (stack == NULL) {
         LSTACK_LOG(ERR, LSTACK, "malloc stack failed\n");
@@ -503,6 +620,10 @@ static struct protocol_stack *stack_thread_init(void *arg)
         }
     }
 
+    if (dpdk_mbuf_cache_init(stack->rxtx_mbuf_pool) != 0) {
+        goto END;
+    }
+
     usleep(SLEEP_US_BEFORE_LINK_UP);
 
     if (ethdev_init(stack) != 0) {
@@ -530,13 +651,25 @@ int stack_polling(unsigned wakeup_tick)
     uint32_t read_connect_number = cfg->read_connect_number;
     struct protocol_stack *stack = get_protocol_stack();
     uint32_t timeout;
+    uint32_t nr_pkts;
+    uint64_t start_tsc = cfg->stack_rebalance ? rte_rdtsc() : 0;
 
     /* 2: one dfx consumes two rpc */
     rpc_poll_msg(&stack->dfx_rpc_queue, 2);
     force_quit = rpc_poll_msg(&stack->rpc_queue, rpc_number);
 
-    eth_dev_poll();
-    timeout = sys_timer_run();
+    /* rte_mempool_in_use_count walks every lcore cache, keep it out of the per-syn path */
+    if (cfg->syn_watermark != 0 && stack->mbuf_in_use_ms != sys_now()) {
+        stack->mbuf_in_use_ms = sys_now();
+        stack->mbuf_in_use = dpdk_mbuf_in_use_count(stack->rxtx_mbuf_pool);
+    }
+
+    nr_pkts = eth_dev_poll();
+    vdev_tx_flush(stack);
+    timeout = stack_timer_run(stack);
+    if (cfg->stack_rebalance) {
+        stack_load_update(stack, nr_pkts, start_tsc);
+    }
     if (cfg->stack_interrupt) {
         intr_wait(stack->stack_idx, timeout);
     }
@@ -595,7 +728,8 @@ static bool stack_local_event_get(uint16_t stack_id)
         !lockless_queue_empty(&stack->rpc_queue.queue) ||
         !list_head_empty(&stack->recv_list) ||
         !list_head_empty(&stack->wakeup_list) ||
-        tx_cache_count(stack->queue_id)) {
+        tx_cache_count(stack->queue_id) ||
+        vdev_tx_pending(stack_id)) {
         return true;
     }
     return false;
@@ -630,6 +764,8 @@ static void* gazelle_stack_thread(void *arg)
         wakeup_tick++;
     }
 
+    ethdev_exit(stack);
+    dpdk_mbuf_cache_exit();
     stack_set_state(stack, WAIT);
 
     return NULL;
@@ -662,7 +798,8 @@ static int stack_group_init_mempool(void)
                 return -1;
             }
 
-            rxtx_mbuf = create_pktmbuf_mempool("rxtx_mbuf", total_mbufs, RXTX_CACHE_SZ, queue_id, numa_id);
+            rxtx_mbuf = create_pktmbuf_mempool("rxtx_mbuf", total_mbufs, dpdk_mbuf_cache_size(total_mbufs),
+                queue_id, numa_id);
             if (rxtx_mbuf == NULL) {
                 LSTACK_LOG(ERR, LSTACK, "numid=%d, rxtx_mbuf idx=%d, create_pktmbuf_mempool fail\n", numa_id, queue_id);
                 return -1;
@@ -273,6 +273,7 @@ static void get_stack_stats(struct gazelle_stack_dfx_data *dfx, struct protocol_
     }
 
     dfx->data.pkts.conn_num = stack->conn_num;
+    dfx->data.pkts.stack_load = stack->load.cpu_usage;
 }
 
 static void get_stack_dfx_data_proto(struct gazelle_stack_dfx_data *dfx, struct protocol_stack *stack,
@@ -403,6 +404,9 @@ int handle_dpdk_cmd(int fd, enum GAZELLE_STAT_MODE stat_mode)
         dpdk_nic_xstats_get(&dfx, get_protocol_stack_group()->port_id);
     } else if (stat_mode == GAZELLE_STAT_LSTACK_SHOW_NIC_FEATURES) {
         dpdk_nic_features_get(&dfx, get_protocol_stack_group()->port_id);
+    } else if (stat_mode == GAZELLE_STAT_LSTACK_SHOW_MEM) {
+        memset_s(&dfx, sizeof(dfx), 0, sizeof(dfx));
+        dpdk_numa_mem_get(&dfx);
     } else {
         return 0;
     }
@@ -634,6 +634,7 @@ static void callback_udp_send(struct rpc_msg *msg)
 {
     int fd = msg->args[MSG_ARG_0].i;
     size_t len = msg->args[MSG_ARG_1].size;
+    size_t gso_size = msg->args[MSG_ARG_3].u;
     struct protocol_stack *stack = get_protocol_stack();
     int ret;
     msg->result = -1;
@@ -647,11 +648,21 @@ static void callback_udp_send(struct rpc_msg *msg)
         calculate_sock_latency(&stack->latency, sock, GAZELLE_LATENCY_WRITE_RPC_MSG);
     }
 
-    ret = lwip_send(fd, sock, len, 0);
-    if (unlikely(ret < 0) && (errno == ENOTCONN || errno == ECONNRESET || errno == ECONNABORTED)) {
-        __sync_fetch_and_sub(&sock->call_num, 1);
-        return;
+    /* UDP_SEGMENT: the app wrote len / gso_size datagrams into send_ring, send them all in this rpc */
+    if (gso_size == 0 || len <= gso_size) {
+        gso_size = len;
+    } else {
+        stack->stats.udp_gso_segs += (len + gso_size - 1) / gso_size;
     }
+    do {
+        size_t seg_len = LWIP_MIN(gso_size, len);
+        ret = lwip_send(fd, sock, seg_len, 0);
+        if (unlikely(ret < 0) && (errno == ENOTCONN || errno == ECONNRESET || errno == ECONNABORTED)) {
+            __sync_fetch_and_sub(&sock->call_num, 1);
+            return;
+        }
+        len -= seg_len;
+    } while (len > 0);
     msg->result = 0;
 
     ret = do_lwip_replenish_sendring(stack, sock);
@@ -664,7 +675,7 @@ static void callback_udp_send(struct rpc_msg *msg)
     return;
 }
 
-int rpc_call_udp_send(rpc_queue *queue, int fd, size_t len, int flags)
+int rpc_call_udp_send(rpc_queue *queue, int fd, size_t len, int flags, uint16_t gso_size)
 {
     struct rpc_msg *msg = rpc_msg_alloc(callback_udp_send);
     if (msg == NULL) {
@@ -678,6 +689,7 @@ int rpc_call_udp_send(rpc_queue *queue, int fd, size_t len, int flags)
     msg->args[MSG_ARG_0].i = fd;
     msg->args[MSG_ARG_1].size = len;
     msg->args[MSG_ARG_2].i = flags;
+    msg->args[MSG_ARG_3].u = gso_size;
 
     rpc_async_call(queue, msg);
     return 0;
@@ -793,6 +805,24 @@ int rpc_call_arp(rpc_queue *queue, void *mbuf)
     return 0;
 }
 
+static void callback_pkts(struct rpc_msg *msg)
+{
+    eth_dev_recv_list((struct rte_mbuf *)msg->args[MSG_ARG_0].p, get_protocol_stack());
+}
+
+int rpc_call_pkts(rpc_queue *queue, void *mbuf_list)
+{
+    struct rpc_msg *msg = rpc_msg_alloc(callback_pkts);
+    if (msg == NULL) {
+        return -1;
+    }
+
+    msg->args[MSG_ARG_0].p = mbuf_list;
+
+    rpc_async_call(queue, msg);
+    return 0;
+}
+
 static void callback_mempool_size(struct rpc_msg *msg)
 {
     struct protocol_stack *stack = get_protocol_stack();
@@ -836,6 +866,24 @@ int rpc_call_connnum(rpc_queue *queue)
     return rpc_sync_call(queue, msg);
 }
 
+static void callback_reta_conn(struct rpc_msg *msg)
+{
+    msg->result = do_lwip_mark_reta_conn((uint8_t *)msg->args[MSG_ARG_0].p, (bool *)msg->args[MSG_ARG_1].p);
+}
+
+int rpc_call_reta_conn(rpc_queue *queue, uint8_t *buckets, bool *udp_bound)
+{
+    struct rpc_msg *msg = rpc_msg_alloc(callback_reta_conn);
+    if (msg == NULL) {
+        return -1;
+    }
+
+    msg->args[MSG_ARG_0].p = buckets;
+    msg->args[MSG_ARG_1].p = udp_bound;
+
+    return rpc_sync_call(queue, msg);
+}
+
 int rpc_call_mbufpoolsize(rpc_queue *queue)
 {
     struct rpc_msg *msg = rpc_msg_alloc(callback_mempool_size);
@@ -10,10 +10,15 @@
  * See the Mulan PSL v2 for more details.
  */
 #include <rte_ethdev.h>
+#include <rte_ring.h>
+#include <rte_errno.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <net/if.h>
 #include <ifaddrs.h>
+#include <numa.h>
 #include <lwip/lwipgz_posix_api.h>
 #include <lwip/dpdk_version.h>
 #include <linux/ipv6.h>
@@ -27,6 +32,9 @@
 #define VIRTIO_USER_NAME "virtio_user"
 #define VIRTIO_DPDK_PARA_LEN 256
 #define VIRTIO_TX_RX_RING_SIZE 1024
+#define VIRTIO_TX_BATCH_SIZE 32
+#define VIRTIO_EXCEPTION_RING_SIZE 1024
+#define VIRTIO_EXCEPTION_IDLE_US 100
 
 #define VIRTIO_NETIF_CHECK_MAX_TIMES 10
 #define VIRTIO_NETIF_CMD_OUTPUT 4096
@@ -34,6 +42,20 @@
 #define VIRTIO_MASK_BITS(mask) (32 - __builtin_clz(mask))
 
 static struct virtio_instance g_virtio_instance = {0};
+
+/* kernel bound packets of one queue, only touched by the stack thread owning the queue */
+struct virtio_tx_batch {
+    uint16_t num;
+    struct rte_mbuf *pkts[VIRTIO_TX_BATCH_SIZE];
+};
+static struct virtio_tx_batch g_virtio_tx_batch[VIRTIO_MAX_QUEUE_NUM];
+
+/* flow_bifurcation_thread: spsc rings between stack of queue and exception thread owning the tap queues */
+static struct rte_ring *g_virtio_to_tap[VIRTIO_MAX_QUEUE_NUM];
+static struct rte_ring *g_virtio_to_nic[VIRTIO_MAX_QUEUE_NUM];
+static bool g_virtio_exception_stop = false;
+static bool g_virtio_exception_running = false;
+static pthread_t g_virtio_exception_tid;
 static char g_virtio_user_name[IFNAMSIZ] = {0};
 struct virtio_instance* virtio_instance_get(void)
 {
@@ -213,13 +235,11 @@ static int virtio_cfg_ip(void)
     return 0;
 }
 
-void virtio_tap_process_rx(uint16_t port, uint32_t queue_id)
+static uint32_t virtio_tap_recv(uint32_t queue_id, struct rte_mbuf **pkts_burst, uint32_t max_num)
 {
-    struct rte_mbuf *pkts_burst[VIRTIO_TX_RX_RING_SIZE];
-    uint16_t lstack_net_port = port;
     uint32_t pkg_num;
 
-    pkg_num = rte_eth_rx_burst(g_virtio_instance.virtio_port_id, queue_id, pkts_burst, VIRTIO_TX_RX_RING_SIZE);
+    pkg_num = rte_eth_rx_burst(g_virtio_instance.virtio_port_id, queue_id, pkts_burst, max_num);
     /*
      * For VLAN, the tap device defaults to tx-vlan-ofload as enabled and will not be modified by default,
      * so the judgment is skipped.
@@ -234,25 +254,67 @@ void virtio_tap_process_rx(uint16_t port, uint32_t queue_id)
         }
     }
 
+    g_virtio_instance.rx_pkg[queue_id] += pkg_num;
+    return pkg_num;
+}
+
+void virtio_tap_process_rx(uint16_t port, uint32_t queue_id)
+{
+    struct rte_mbuf *pkts_burst[VIRTIO_TX_RX_RING_SIZE];
+    uint16_t lstack_net_port = port;
+    uint32_t pkg_num;
+
+    if (g_virtio_to_nic[queue_id] != NULL) {
+        pkg_num = rte_ring_sc_dequeue_burst(g_virtio_to_nic[queue_id], (void **)pkts_burst,
+            VIRTIO_TX_RX_RING_SIZE, NULL);
+    } else {
+        pkg_num = virtio_tap_recv(queue_id, pkts_burst, VIRTIO_TX_RX_RING_SIZE);
+    }
+
     if (pkg_num > 0) {
-        g_virtio_instance.rx_pkg[queue_id] += pkg_num;
         uint16_t nb_rx = rte_eth_tx_burst(lstack_net_port, queue_id, pkts_burst, pkg_num);
         for (uint16_t i = nb_rx; i < pkg_num; ++i) {
             rte_pktmbuf_free(pkts_burst[i]);
-            g_virtio_instance.rx_drop[queue_id]++;
         }
+        if (nb_rx < pkg_num) {
+            __atomic_fetch_add(&g_virtio_instance.rx_drop[queue_id], pkg_num - nb_rx, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void virtio_tap_flush_tx(uint16_t queue_id)
+{
+    struct virtio_tx_batch *batch = &g_virtio_tx_batch[queue_id];
+    uint16_t tx_num;
+
+    if (batch->num == 0) {
+        return;
+    }
+
+    if (g_virtio_to_tap[queue_id] != NULL) {
+        tx_num = rte_ring_sp_enqueue_burst(g_virtio_to_tap[queue_id], (void **)batch->pkts, batch->num, NULL);
+    } else {
+        tx_num = rte_eth_tx_burst(g_virtio_instance.virtio_port_id, queue_id, batch->pkts, batch->num);
+        g_virtio_instance.tx_pkg[queue_id] += tx_num;
+    }
+    for (uint16_t i = tx_num; i < batch->num; i++) {
+        rte_pktmbuf_free(batch->pkts[i]);
+    }
+    if (tx_num < batch->num) {
+        __atomic_fetch_add(&g_virtio_instance.tx_drop[queue_id], batch->num - tx_num, __ATOMIC_RELAXED);
     }
+    batch->num = 0;
 }
 
-void virtio_tap_process_tx(uint16_t queue_id, struct rte_mbuf *mbuf_copy)
+/* takes ownership of mbuf, it is sent by virtio_tap_flush_tx at the end of the poll or when batch is full */
+void virtio_tap_process_tx(uint16_t queue_id, struct rte_mbuf *mbuf)
 {
-    int tx_num = rte_eth_tx_burst(g_virtio_instance.virtio_port_id, queue_id, &(mbuf_copy), 1);
-    if (tx_num < 0) {
-        rte_pktmbuf_free(mbuf_copy);
-        g_virtio_instance.tx_drop[queue_id]++;
-        LSTACK_LOG(ERR, LSTACK, "virtio_tap_process_tx failed %d, %d\n", queue_id, tx_num);
+    struct virtio_tx_batch *batch = &g_virtio_tx_batch[queue_id];
+
+    batch->pkts[batch->num++] = mbuf;
+    if (batch->num == VIRTIO_TX_BATCH_SIZE) {
+        virtio_tap_flush_tx(queue_id);
     }
-    g_virtio_instance.tx_pkg[queue_id]++;
 }
 
 static int virtio_port_init(uint16_t port)
@@ -275,7 +337,9 @@ static int virtio_port_init(uint16_t port)
         return retval;
     }
 
-    port_conf.intr_conf.rxq = get_global_cfg_params()->stack_interrupt;
+    /* tap queues of exception thread are polled, not waited by stack threads */
+    port_conf.intr_conf.rxq = get_global_cfg_params()->stack_interrupt &&
+        !get_global_cfg_params()->flow_bifurcation_thread;
     retval = rte_eth_dev_configure(port, rx_queue_num, tx_queue_num, &port_conf);
     if (retval != 0) {
         LSTACK_LOG(ERR, LSTACK, "rte_eth_dev_configure failed retval=%d\n", retval);
@@ -354,6 +418,172 @@ static int virtio_get_netif_num(void)
     return netif_num;
 }
 
+/* keep the exception thread on the non-stack cpus of the stack numa, so it never steals a stack core */
+static void virtio_exception_affinity(void)
+{
+    struct cfg_params *cfg = get_global_cfg_params();
+    uint32_t cpulist[CPUS_MAX_NUM];
+    cpu_set_t cpuset;
+    int32_t cpunum;
+    int32_t numa_id;
+    int32_t ret;
+
+    if (cfg->stack_num > 0) {
+        /* stack threads float on the numa, no cpu is reserved for them */
+        numa_run_on_node(cfg->numa_id);
+        return;
+    }
+
+    numa_id = numa_node_of_cpu(cfg->cpus[0]);
+    cpunum = (numa_id < 0) ? -1 : numa_to_cpusnum(numa_id, cpulist, CPUS_MAX_NUM);
+    if (cpunum <= 0) {
+        LSTACK_LOG(ERR, LSTACK, "numa_to_cpusnum failed\n");
+        return;
+    }
+
+    CPU_ZERO(&cpuset);
+    for (int32_t i = 0; i < cpunum; i++) {
+        CPU_SET(cpulist[i], &cpuset);
+    }
+    for (uint16_t i = 0; i < cfg->num_cpu; i++) {
+        CPU_CLR(cfg->cpus[i], &cpuset);
+    }
+    for (uint16_t i = 0; i < cfg->app_exclude_num_cpu; i++) {
+        CPU_CLR(cfg->app_exclude_cpus[i], &cpuset);
+    }
+    if (CPU_COUNT(&cpuset) == 0) {
+        LSTACK_LOG(WARNING, LSTACK, "no idle cpu in numa %d, gazelleexcept may share a stack cpu\n", numa_id);
+        numa_run_on_node(numa_id);
+        return;
+    }
+
+    ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (ret != 0) {
+        LSTACK_LOG(ERR, LSTACK, "gazelleexcept pthread_setaffinity_np failed ret=%d\n", ret);
+    }
+}
+
+/* queue ids of a process are process_idx * num_queue + stack_idx, see stack_setup_thread */
+static int virtio_queue_to_stack(uint16_t queue_id)
+{
+    struct cfg_params *cfg = get_global_cfg_params();
+    int stack_idx = (int)queue_id - (int)cfg->process_idx * (int)cfg->num_queue;
+
+    return (stack_idx >= 0 && stack_idx < cfg->num_queue) ? stack_idx : -1;
+}
+
+/* moves kernel traffic between stack rings and tap queues, so a kernel burst never runs in stack thread */
+static void *virtio_exception_thread(void *arg)
+{
+    struct rte_mbuf *pkts[VIRTIO_TX_BATCH_SIZE];
+    uint16_t virtio_port = g_virtio_instance.virtio_port_id;
+    uint32_t num;
+    uint32_t done;
+
+    virtio_exception_affinity();
+
+    while (!__atomic_load_n(&g_virtio_exception_stop, __ATOMIC_ACQUIRE)) {
+        uint32_t busy = 0;
+
+        for (uint16_t q = 0; q < VIRTIO_MAX_QUEUE_NUM; q++) {
+            if (g_virtio_to_tap[q] != NULL) {
+                num = rte_ring_sc_dequeue_burst(g_virtio_to_tap[q], (void **)pkts, VIRTIO_TX_BATCH_SIZE, NULL);
+                done = (num == 0) ? 0 : rte_eth_tx_burst(virtio_port, q, pkts, num);
+                g_virtio_instance.tx_pkg[q] += done;
+                for (uint32_t i = done; i < num; i++) {
+                    rte_pktmbuf_free(pkts[i]);
+                }
+                if (done < num) {
+                    __atomic_fetch_add(&g_virtio_instance.tx_drop[q], num - done, __ATOMIC_RELAXED);
+                }
+                busy += num;
+            }
+
+            if (g_virtio_to_nic[q] != NULL) {
+                num = virtio_tap_recv(q, pkts, VIRTIO_TX_BATCH_SIZE);
+                done = (num == 0) ? 0 : rte_ring_sp_enqueue_burst(g_virtio_to_nic[q], (void **)pkts, num, NULL);
+                for (uint32_t i = done; i < num; i++) {
+                    rte_pktmbuf_free(pkts[i]);
+                }
+                if (done < num) {
+                    __atomic_fetch_add(&g_virtio_instance.rx_drop[q], num - done, __ATOMIC_RELAXED);
+                }
+                if (done > 0) {
+                    intr_wakeup(virtio_queue_to_stack(q), INTR_REMOTE_EVENT);
+                }
+                busy += num;
+            }
+        }
+
+        if (busy == 0) {
+            usleep(VIRTIO_EXCEPTION_IDLE_US);
+        }
+    }
+    return NULL;
+}
+
+static struct rte_ring *virtio_exception_ring_create(const char *prefix, uint16_t queue_id)
+{
+    char name[RTE_RING_NAMESIZE] = {0};
+    struct rte_ring *ring;
+
+    /* ring names are global to all processes of the primary */
+    if (snprintf_s(name, sizeof(name), sizeof(name) - 1, "%s_%hhu_%hu", prefix,
+        get_global_cfg_params()->process_idx, queue_id) < 0) {
+        return NULL;
+    }
+    ring = rte_ring_create(name, VIRTIO_EXCEPTION_RING_SIZE, rte_socket_id(), RING_F_SP_ENQ | RING_F_SC_DEQ);
+    if (ring == NULL) {
+        LSTACK_LOG(ERR, LSTACK, "rte_ring_create %s failed, %s\n", name, rte_strerror(rte_errno));
+    }
+    return ring;
+}
+
+static int virtio_exception_thread_start(void)
+{
+    int ret;
+
+    /* only the queues of stacks in this process get rings, other queues belong to other processes */
+    for (uint16_t q = 0; q < g_virtio_instance.tx_queue_num; q++) {
+        if (virtio_queue_to_stack(q) < 0) {
+            continue;
+        }
+        g_virtio_to_tap[q] = virtio_exception_ring_create("virtio_to_tap", q);
+        if (g_virtio_to_tap[q] == NULL) {
+            return -1;
+        }
+    }
+    for (uint16_t q = 0; q < g_virtio_instance.rx_queue_num; q++) {
+        if (virtio_queue_to_stack(q) < 0) {
+            continue;
+        }
+        g_virtio_to_nic[q] = virtio_exception_ring_create("virtio_to_nic", q);
+        if (g_virtio_to_nic[q] == NULL) {
+            return -1;
+        }
+    }
+
+    ret = pthread_create(&g_virtio_exception_tid, NULL, virtio_exception_thread, NULL);
+    if (ret != 0) {
+        LSTACK_LOG(ERR, LSTACK, "pthread_create ret=%d\n", ret);
+        return -1;
+    }
+    pthread_setname_np(g_virtio_exception_tid, "gazelleexcept");
+    g_virtio_exception_running = true;
+    return 0;
+}
+
+void virtio_exception_thread_stop(void)
+{
+    if (!g_virtio_exception_running) {
+        return;
+    }
+    __atomic_store_n(&g_virtio_exception_stop, true, __ATOMIC_RELEASE);
+    /* one round is bounded by the burst sizes, the join does not wait long */
+    (void)pthread_join(g_virtio_exception_tid, NULL);
+    g_virtio_exception_running = false;
+}
+
 int virtio_port_create(int lstack_net_port)
 {
     char portargs[VIRTIO_DPDK_PARA_LEN] = {0};
@@ -428,6 +658,11 @@ int virtio_port_create(int lstack_net_port)
         rte_eal_hotplug_remove("vdev", g_virtio_user_name);
         return retval;
     }
+
+    if (get_global_cfg_params()->flow_bifurcation_thread && virtio_exception_thread_start() != 0) {
+        LSTACK_LOG(ERR, LSTACK, "virtio_exception_thread_start failed\n");
+        return -1;
+    }
     return 0;
 }
 
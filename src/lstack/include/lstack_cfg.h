@@ -110,6 +110,7 @@ struct cfg_params {
         uint16_t tot_queue_num;
         bool send_cache_mode;
         bool flow_bifurcation;
+        bool flow_bifurcation_thread; // true: tap queues are served by one exception thread through rings
         int32_t vlan_mode;
     };
 
@@ -125,8 +126,18 @@ struct cfg_params {
         uint32_t app_exclude_cpus[CPUS_MAX_NUM];
 
         bool stack_mode_rtc;
+        uint32_t rtc_epoll_rx_batch; // rtc epoll_wait polls nic until this many pkts received, 0: one round
         bool listen_shadow; // true:listen in all stack thread. false:listen in one stack thread.
+        bool listen_reuseport; // true:listen in stack of app thread, other stacks steer packets to it by hash.
         bool stack_interrupt;
+        bool stack_rebalance; // true: place new connections by measured stack load.
+        bool fork_defer_init; // true: process keeps kernel path, its first forked child starts lstack.
+        bool conn_compact; // true: tcp send_ring is filled on demand instead of at socket creation.
+        uint32_t gro_max_flow_num;
+        uint32_t gro_max_item_per_flow;
+        bool rx_sw_cksum; // true: rx cksums the nic does not offload are verified before gro and lwip
+        uint32_t syn_watermark; // percent of accept queue or rxtx mbuf pool in use above which syn is dropped
+        uint32_t rss_rebalance_interval; // seconds between rss reta rebalance rounds, 0: static reta
 
         uint32_t read_connect_number;
         uint32_t nic_read_number;
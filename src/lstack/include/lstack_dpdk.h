@@ -21,6 +21,8 @@
 #include "common/gazelle_dfx_msg.h"
 
 #define RXTX_CACHE_SZ        (VDEV_RX_QUEUE_SZ)
+#define DPDK_RX_CKSUM_OL     (RTE_ETH_RX_OFFLOAD_IPV4_CKSUM | RTE_ETH_RX_OFFLOAD_TCP_CKSUM | \
+                              RTE_ETH_RX_OFFLOAD_UDP_CKSUM)
 
 #define KNI_NB_MBUF          (DEFAULT_RING_SIZE << 4)
 
@@ -49,11 +51,18 @@ int thread_affinity_default(void);
 int32_t create_shared_ring(struct protocol_stack *stack);
 int32_t fill_mbuf_to_ring(struct rte_mempool *mempool, struct rte_ring *ring, uint32_t mbuf_num);
 int32_t pktmbuf_pool_init(struct protocol_stack *stack);
+int32_t dpdk_thread_numa_id(void);
 struct rte_mempool *create_mempool(const char *name, uint32_t count, uint32_t size,
                                    uint32_t flags, int32_t idx);
 struct rte_mempool *create_pktmbuf_mempool(const char *name, uint32_t nb_mbuf,
                                            uint32_t mbuf_cache_size, uint16_t queue_id, unsigned numa_id);
 int32_t dpdk_alloc_pktmbuf(struct rte_mempool *pool, struct rte_mbuf **mbufs, uint32_t num, bool reserve);
+void dpdk_free_pktmbuf_seg(struct rte_mbuf *mbuf);
+uint32_t dpdk_mbuf_cache_size(uint32_t nb_mbuf);
+uint64_t dpdk_sw_rx_cksum_ol(void);
+int32_t dpdk_mbuf_cache_init(struct rte_mempool *pool);
+void dpdk_mbuf_cache_exit(void);
+uint32_t dpdk_mbuf_in_use_count(struct rte_mempool *pool);
 
 #if RTE_VERSION < RTE_VERSION_NUM(23, 11, 0, 0)
 void dpdk_skip_nic_init(void);
@@ -63,8 +72,14 @@ int32_t dpdk_init_lstack_kni(void);
 
 void dpdk_nic_xstats_get(struct gazelle_stack_dfx_data *dfx, uint16_t port_id);
 void dpdk_nic_features_get(struct gazelle_stack_dfx_data *dfx, uint16_t port_id);
+void dpdk_numa_mem_get(struct gazelle_stack_dfx_data *dfx);
 
 uint32_t dpdk_pktmbuf_mempool_num(void);
 uint32_t dpdk_total_socket_memory(void);
 
+uint32_t dpdk_reta_index(const gz_addr_t *src_ip, const gz_addr_t *dst_ip, uint16_t src_port, uint16_t dst_port);
+void dpdk_rss_reta_account(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t num);
+int32_t dpdk_rss_rebalance_start(void);
+void dpdk_rss_rebalance_stop(void);
+
 #endif /* GAZELLE_DPDK_H */
@@ -23,6 +23,7 @@
 
 #include "common/gazelle_dfx_msg.h"
 #include "common/gazelle_opt.h"
+#include "lstack_lockless_queue.h"
 
 enum wakeup_type {
     WAKEUP_EPOLL = 0,
@@ -50,6 +51,10 @@ struct wakeup_poll {
     nfds_t last_nfds;
     nfds_t last_max_nfds;
     struct epoll_event *events;
+    uint32_t *poll_index; /* fd -> slot + 1 in fds of last poll, 0: not watched */
+    uint64_t *ready_bits; /* fd bitmap raised by stack threads, harvested by poll */
+    uint64_t *ready_summary; /* bitmap of ready_bits words that may be non zero */
+    bool poll_scan_all; /* same fd in several slots, check every fd as before */
 
     /* epoll */
     int32_t epollfd; /* epoll kernel fd */
@@ -57,12 +62,16 @@ struct wakeup_poll {
     struct protocol_stack *max_stack;
     struct list_node event_list;
     pthread_spinlock_t event_list_lock;
+    /* rtw: stack threads publish ready sockets here without lock, app thread moves them into event_list */
+    lockless_queue ready_queue;
 };
 
 void add_sock_event(struct lwip_sock *sock, uint32_t event);
 void add_sock_event_nolock(struct lwip_sock *sock, uint32_t event);
 void del_sock_event(struct lwip_sock *sock, uint32_t event);
 void del_sock_event_nolock(struct lwip_sock *sock, uint32_t event);
+void reclaim_sock_event_node(struct lwip_sock *sock, int32_t fd);
+void release_sock_event_node(int32_t fd);
 
 void wakeup_stack_epoll(struct protocol_stack *stack);
 
@@ -24,8 +24,10 @@ struct lstack_dev_ops {
 };
 
 int32_t ethdev_init(struct protocol_stack *stack);
+void ethdev_exit(struct protocol_stack *stack);
 int32_t eth_dev_poll(void);
 void eth_dev_recv(struct rte_mbuf *mbuf, struct protocol_stack *stack);
+void eth_dev_recv_list(struct rte_mbuf *mbuf, struct protocol_stack *stack);
 
 #if RTE_VERSION < RTE_VERSION_NUM(23, 11, 0, 0)
 void kni_handle_rx(uint16_t port_id);
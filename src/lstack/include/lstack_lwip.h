@@ -23,6 +23,10 @@ struct protocol_stack;
 
 unsigned same_node_ring_count(struct lwip_sock *sock);
 
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
 #define NETCONN_IS_ACCEPTIN(sock)   (((sock)->conn->acceptmbox != NULL) && !sys_mbox_empty((sock)->conn->acceptmbox))
 #define NETCONN_IS_DATAIN(sock)     ((gazelle_ring_readable_count((sock)->recv_ring) || (sock)->recv_lastdata) || (sock->same_node_rx_ring != NULL && same_node_ring_count(sock)))
 #define NETCONN_IS_DATAOUT(sock)    (gazelle_ring_readover_count((sock)->send_ring) || (sock)->send_pre_del)
@@ -55,13 +59,19 @@ ssize_t do_lwip_send_to_stack(int32_t fd, const void *buf, size_t len, int32_t f
 ssize_t do_lwip_read_from_stack(int32_t fd, void *buf, size_t len, int32_t flags,
                                 struct sockaddr *addr, socklen_t *addrlen);
 
+int do_lwip_set_udp_gso(int fd, const void *optval, socklen_t optlen);
+int do_lwip_get_udp_gso(int fd, void *optval, socklen_t *optlen);
+
 /* stack api */
 bool do_lwip_replenish_sendring(struct protocol_stack *stack, struct lwip_sock *sock);
 
 void do_lwip_clone_sockopt(struct lwip_sock *dst_sock, struct lwip_sock *src_sock);
 
+bool do_lwip_syn_overload(struct protocol_stack *stack, const gz_addr_t *local_ip, uint16_t port);
+
 uint32_t do_lwip_get_conntable(struct gazelle_stat_lstack_conn_info *conn, uint32_t max_num);
 uint32_t do_lwip_get_connnum(void);
+uint32_t do_lwip_mark_reta_conn(uint8_t *buckets, bool *udp_bound);
 
 void read_same_node_recv_list(struct protocol_stack *stack);
 
@@ -36,6 +36,20 @@
 
 #define MBUFPOOL_RESERVE_NUM (2 * get_global_cfg_params()->rxqueue_size + 1024)
 
+#define STACK_LOAD_INTERVAL_MS      100
+#define STACK_LOAD_TOLERANCE        10  /* cpu usage percent regarded as equal load */
+#define STACK_LOAD_RATE_SHIFT       3   /* rx rates within 1/8 of each other regarded as equal load */
+
+/* written only by the owner stack thread, read by app threads when placing connections */
+struct stack_load {
+    uint64_t busy_tsc;
+    uint64_t last_tsc;
+    uint64_t last_busy_tsc;
+    uint64_t last_rx_pkts;
+    uint32_t cpu_usage; /* percent of polling time spent on rx, smoothed */
+    uint32_t rx_rate;   /* rx pkts per interval, smoothed */
+};
+
 struct protocol_stack {
     uint32_t tid;
     uint16_t queue_id;
@@ -69,8 +83,12 @@ struct protocol_stack {
 
     struct netif netif;
     struct lstack_dev_ops dev_ops;
+    struct eth_steer *steer; /* listen_reuseport flows handed to other stacks */
+    void *gro_ctx; /* rx gro table, flushed every poll */
     uint32_t rx_ring_used;
     uint32_t tx_ring_used;
+    uint32_t mbuf_in_use; /* rxtx pool mbufs in use, sampled once per ms for syn_watermark */
+    uint32_t mbuf_in_use_ms;
 
     struct rte_mbuf *pkts[NIC_QUEUE_SIZE_MAX];
     struct list_node recv_list;
@@ -78,6 +96,7 @@ struct protocol_stack {
     struct list_node wakeup_list;
 
     volatile uint16_t conn_num;
+    struct stack_load load;
     struct stats_ *lwip_stats;
     struct gazelle_stack_latency latency;
     struct gazelle_stack_stat stats;
@@ -90,6 +109,7 @@ struct protocol_stack_group {
     uint16_t port_id;
     uint64_t rx_offload;
     uint64_t tx_offload;
+    bool rx_ptype_hw;
     struct rte_mempool *kni_pktmbuf_pool;
     struct eth_params *eth_params;
     struct protocol_stack *stacks[PROTOCOL_STACK_MAX];
@@ -114,6 +134,12 @@ struct protocol_stack *get_bind_protocol_stack(void);
 struct protocol_stack_group *get_protocol_stack_group(void);
 
 int get_min_conn_stack(struct protocol_stack_group *stack_group);
+bool stack_load_less(const struct protocol_stack *stack, const struct protocol_stack *other);
+
+void stack_reuseport_add(uint16_t port, uint32_t stack_idx);
+void stack_reuseport_del(uint16_t port, uint32_t stack_idx);
+bool stack_reuseport_left(uint16_t port, uint32_t stack_idx);
+int stack_reuseport_select(uint16_t port, uint32_t hash, uint32_t cur_idx);
 void bind_to_stack_numa(struct protocol_stack *stack);
 void thread_bind_stack(struct protocol_stack *stack);
 
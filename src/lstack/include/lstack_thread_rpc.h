@@ -14,6 +14,7 @@
 #define __GAZELLE_THREAD_RPC_H__
 
 #include <pthread.h>
+#include <stdbool.h>
 #include <rte_mempool.h>
 
 #include "lstack_lockless_queue.h"
@@ -96,17 +97,19 @@ int rpc_call_getsockopt(rpc_queue *queue, int fd, int level, int optname, void *
 int rpc_call_setsockopt(rpc_queue *queue, int fd, int level, int optname, const void *optval, socklen_t optlen);
 
 int rpc_call_tcp_send(rpc_queue *queue, int fd, size_t len, int flags);
-int rpc_call_udp_send(rpc_queue *queue, int fd, size_t len, int flags);
+int rpc_call_udp_send(rpc_queue *queue, int fd, size_t len, int flags, uint16_t gso_size);
 
 int rpc_call_replenish(rpc_queue *queue, void *sock);
 int rpc_call_recvlistcnt(rpc_queue *queue);
 
 int rpc_call_clean_epoll(rpc_queue *queue, void *wakeup);
 int rpc_call_arp(rpc_queue *queue, void *mbuf);
+int rpc_call_pkts(rpc_queue *queue, void *mbuf_list);
 
 int rpc_call_conntable(rpc_queue *queue, void *conn_table, unsigned max_conn);
 int rpc_call_connnum(rpc_queue *queue);
 int rpc_call_mbufpoolsize(rpc_queue *queue);
+int rpc_call_reta_conn(rpc_queue *queue, uint8_t *buckets, bool *udp_bound);
 
 int rpc_call_thread_regphase1(rpc_queue *queue, void *conn);
 int rpc_call_thread_regphase2(rpc_queue *queue, void *conn);
@@ -13,11 +13,19 @@
 #ifndef _GAZELLE_VDEV_H_
 #define _GAZELLE_VDEV_H_
 
+#include <stdbool.h>
+
+struct pbuf;
 struct lstack_dev_ops;
 struct gazelle_quintuple;
 enum reg_ring_type;
 void vdev_dev_ops_init(struct lstack_dev_ops *dev_ops);
 int vdev_reg_xmit(enum reg_ring_type type, struct gazelle_quintuple *qtuple);
 uint32_t vdev_tx_xmit(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts);
+void vdev_tx_flush(struct protocol_stack *stack);
+int32_t vdev_gro_init(struct protocol_stack *stack);
+void vdev_gro_exit(struct protocol_stack *stack);
+uint32_t vdev_tx_pending(uint16_t stack_idx);
+bool vdev_tx_backlogged(const struct pbuf *p);
 
 #endif /* _GAZELLE_VDEV_H_ */
@@ -44,9 +44,11 @@ struct virtio_instance {
 };
 
 void virtio_tap_process_rx(uint16_t port, uint32_t queue_id);
-void virtio_tap_process_tx(uint16_t queue_id, struct rte_mbuf *mbuf_copy);
+void virtio_tap_process_tx(uint16_t queue_id, struct rte_mbuf *mbuf);
+void virtio_tap_flush_tx(uint16_t queue_id);
 
 int virtio_port_create(int lstack_net_port);
+void virtio_exception_thread_stop(void);
 
 struct virtio_instance* virtio_instance_get(void);
 bool virtio_distribute_pkg_to_kernel(uint16_t dst_port);
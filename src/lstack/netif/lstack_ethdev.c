@@ -16,6 +16,11 @@
 #include <rte_kni.h>
 #endif
 #include <rte_ethdev.h>
+#include <rte_jhash.h>
+#include <rte_arp.h>
+#include <rte_spinlock.h>
+#include <rte_prefetch.h>
+#include <rte_tcp.h>
 
 #include <lwip/etharp.h>
 #include <lwip/ethip6.h>
@@ -42,10 +47,247 @@
 /* FRAME_MTU + 14byte header */
 #define MBUF_MAX_LEN                            1514
 #define PACKET_READ_SIZE                        32
+#define RX_PREFETCH_OFFSET                      4
+/* packets grouped by flow at a time, indexes fit in uint8_t */
+#define RX_FLOW_GROUP_MAX                       64
+#define RX_FLOW_GROUP_NONE                      0xff
+/* power of 2, larger than RX_FLOW_GROUP_MAX */
+#define RX_FLOW_TBL_SIZE                        128
+#define RX_FLOW_TBL_PROBE                       8
 
-/* any protocol stack thread receives arp packet and sync it to other threads,
- * so that it can have the arp table */
-static void stack_broadcast_arp(struct rte_mbuf *mbuf, struct protocol_stack *cur_stack)
+#define IS_ARP_PKT(ptype) ((ptype & RTE_PTYPE_L2_ETHER_ARP) == RTE_PTYPE_L2_ETHER_ARP)
+#define IS_IPV4_TCP_PKT(ptype) (RTE_ETH_IS_IPV4_HDR(ptype) && \
+        ((ptype & RTE_PTYPE_L4_TCP) == RTE_PTYPE_L4_TCP) && \
+        ((ptype & RTE_PTYPE_L4_FRAG) != RTE_PTYPE_L4_FRAG) && \
+        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
+
+#define IS_IPV6_TCP_PKT(ptype) (RTE_ETH_IS_IPV6_HDR(ptype) && \
+        ((ptype & RTE_PTYPE_L4_TCP) == RTE_PTYPE_L4_TCP) && \
+        ((ptype & RTE_PTYPE_L4_FRAG) != RTE_PTYPE_L4_FRAG) && \
+        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
+
+#define IS_IPV4_UDP_PKT(ptype) (RTE_ETH_IS_IPV4_HDR(ptype) && \
+        ((ptype & RTE_PTYPE_L4_UDP) == RTE_PTYPE_L4_UDP) && \
+        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
+
+#define IS_IPV6_UDP_PKT(ptype) (RTE_ETH_IS_IPV6_HDR(ptype) && \
+        ((ptype & RTE_PTYPE_L4_UDP) == RTE_PTYPE_L4_UDP) && \
+        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
+
+#define IS_ICMPV6_PKT(ptype) (RTE_ETH_IS_IPV6_HDR(ptype) && \
+        ((ptype & RTE_PTYPE_L4_ICMP) == RTE_PTYPE_L4_ICMP) && \
+        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
+
+/* listen_reuseport flow table per stack, power of 2 */
+#define STEER_FLOW_TBL_SIZE                     16384
+#define STEER_FLOW_TBL_PROBE                    8
+/* a slot is reused this long after fin/rst, live flows are never evicted */
+#define STEER_FLOW_CLOSE_MS                     (10 * 1000)
+
+#define NEIGH_TABLE_SIZE                        ARP_MAX_ENTRIES
+#define NEIGH_TABLE_MASK                        (NEIGH_TABLE_SIZE - 1)
+#define NEIGH_PROBE_MAX                         8
+/* same as lwip ARP_MAXAGE, older entries fall back to etharp of the stack */
+#define NEIGH_MAX_AGE_MS                        (300 * 1000)
+/* fast path traffic bypasses etharp_output, so entries are re-requested from here once half aged */
+#define NEIGH_REFRESH_AGE_MS                    (NEIGH_MAX_AGE_MS / 2)
+#define NEIGH_REFRESH_RETRY_MS                  (1000)
+/* same as lwip ARP_MAXPENDING, etharp gives up an unanswered request after this, so do the waiters */
+#define NEIGH_WAIT_MAX_MS                       (5 * 1000)
+#define NEIGH_ALL_STACKS                        UINT32_MAX
+
+/* process wide ipv4 neighbor table. any stack receiving arp writes it under g_neigh_lock,
+ * every stack reads it lock-free in eth_dev_ip4_output, seq is odd while an entry is written.
+ * slots are never emptied, so a probe can stop at the first empty slot. */
+struct neigh_entry {
+    uint32_t seq;
+    uint32_t ip;            /* network order, 0: empty slot */
+    uint32_t update_ms;     /* 0: unresolved */
+    uint32_t waiters;       /* stacks whose etharp is resolving ip, they still need the arp packet */
+    uint32_t wait_ms;       /* last waiter added, under g_neigh_lock */
+    uint32_t refresh_ms;    /* last arp request sent to refresh the entry, under g_neigh_lock */
+    struct eth_addr mac;
+};
+_Static_assert((NEIGH_TABLE_SIZE & NEIGH_TABLE_MASK) == 0, "NEIGH_TABLE_SIZE must be a power of 2");
+static struct neigh_entry g_neigh_table[NEIGH_TABLE_SIZE];
+static rte_spinlock_t g_neigh_lock = RTE_SPINLOCK_INITIALIZER;
+
+static void neigh_read(const struct neigh_entry *entry, struct neigh_entry *copy)
+{
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        copy->ip = entry->ip;
+        copy->update_ms = entry->update_ms;
+        copy->mac = entry->mac;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&entry->seq, __ATOMIC_RELAXED));
+}
+
+/* age is set to the entry's age in ms when ip is resolved */
+static bool neigh_lookup(uint32_t ip, struct eth_addr *mac, uint32_t *age)
+{
+    uint32_t idx = rte_jhash_1word(ip, 0);
+    struct neigh_entry copy;
+
+    for (uint32_t i = 0; i < NEIGH_PROBE_MAX; i++) {
+        neigh_read(&g_neigh_table[(idx + i) & NEIGH_TABLE_MASK], &copy);
+        if (copy.ip == 0) {
+            return false;
+        }
+        if (copy.ip == ip) {
+            *mac = copy.mac;
+            *age = sys_now() - copy.update_ms;
+            return copy.update_ms != 0 && *age < NEIGH_MAX_AGE_MS;
+        }
+    }
+    return false;
+}
+
+/* called with g_neigh_lock held. returns slot of ip, or a slot to reuse when create.
+ * slots with waiters are not reused until etharp of the waiters gave up; NULL if all have one */
+static struct neigh_entry *neigh_find_locked(uint32_t ip, bool create)
+{
+    uint32_t idx = rte_jhash_1word(ip, 0);
+    uint32_t now = sys_now();
+    struct neigh_entry *oldest = NULL;
+
+    for (uint32_t i = 0; i < NEIGH_PROBE_MAX; i++) {
+        struct neigh_entry *entry = &g_neigh_table[(idx + i) & NEIGH_TABLE_MASK];
+        if (entry->ip == ip) {
+            return entry;
+        }
+        if (entry->ip == 0) {
+            return create ? entry : NULL;
+        }
+        if (entry->waiters != 0 && now - entry->wait_ms < NEIGH_WAIT_MAX_MS) {
+            continue;
+        }
+        if (oldest == NULL || (int32_t)(entry->update_ms - oldest->update_ms) < 0) {
+            oldest = entry;
+        }
+    }
+    return create ? oldest : NULL;
+}
+
+/* one stack re-requests an aging entry, a reply to us updates it in neigh_learn */
+static bool neigh_refresh_claim(uint32_t ip)
+{
+    uint32_t now = sys_now();
+    bool claim = false;
+
+    rte_spinlock_lock(&g_neigh_lock);
+    struct neigh_entry *entry = neigh_find_locked(ip, false);
+    if (entry != NULL && entry->ip == ip && now - entry->refresh_ms >= NEIGH_REFRESH_RETRY_MS) {
+        entry->refresh_ms = now;
+        claim = true;
+    }
+    rte_spinlock_unlock(&g_neigh_lock);
+    return claim;
+}
+
+static void neigh_write_locked(struct neigh_entry *entry, uint32_t ip, uint32_t update_ms,
+    uint32_t waiters, const struct eth_addr *mac)
+{
+    __atomic_store_n(&entry->seq, entry->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    entry->ip = ip;
+    entry->update_ms = update_ms;
+    entry->waiters = waiters;
+    if (mac != NULL) {
+        entry->mac = *mac;
+    }
+    __atomic_store_n(&entry->seq, entry->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* stack falls back to its own etharp, remember it wants the reply */
+static void neigh_add_waiter(uint32_t ip, uint16_t stack_idx)
+{
+    rte_spinlock_lock(&g_neigh_lock);
+    struct neigh_entry *entry = neigh_find_locked(ip, true);
+    if (entry == NULL) {
+        /* every slot is being resolved, the reply is still learned by the table when a slot frees */
+    } else if (entry->ip == ip) {
+        entry->waiters |= 1U << stack_idx;
+        entry->wait_ms = sys_now();
+    } else {
+        neigh_write_locked(entry, ip, 0, 1U << stack_idx, NULL);
+        entry->wait_ms = sys_now();
+    }
+    rte_spinlock_unlock(&g_neigh_lock);
+}
+
+/* learn sender of an arp packet, like etharp_input: new entries only for arp sent to us.
+ * returns stacks that wait for this arp */
+static uint32_t neigh_learn(struct rte_mbuf *mbuf, struct protocol_stack *stack)
+{
+    const struct rte_arp_hdr *arp_hdr;
+    struct eth_addr mac;
+    uint32_t waiters = 0;
+    uint32_t now;
+
+    if (rte_pktmbuf_data_len(mbuf) < mbuf->l2_len + sizeof(struct rte_arp_hdr)) {
+        return 0;
+    }
+    arp_hdr = rte_pktmbuf_mtod_offset(mbuf, const struct rte_arp_hdr *, mbuf->l2_len);
+    if (arp_hdr->arp_hardware != RTE_BE16(RTE_ARP_HRD_ETHER) ||
+        arp_hdr->arp_protocol != RTE_BE16(RTE_ETHER_TYPE_IPV4) ||
+        arp_hdr->arp_data.arp_sip == 0) {
+        return 0;
+    }
+
+    uint32_t sip = arp_hdr->arp_data.arp_sip;
+    bool for_us = arp_hdr->arp_data.arp_tip == ip4_addr_get_u32(netif_ip4_addr(&stack->netif));
+    (void)memcpy_s(mac.addr, sizeof(mac.addr), &arp_hdr->arp_data.arp_sha, ETH_HWADDR_LEN);
+    now = sys_now();
+
+    rte_spinlock_lock(&g_neigh_lock);
+    struct neigh_entry *entry = neigh_find_locked(sip, for_us);
+    if (entry != NULL) {
+        if (entry->ip == sip) {
+            waiters = entry->waiters;
+        }
+        neigh_write_locked(entry, sip, (now == 0) ? 1 : now, 0, &mac);
+    }
+    rte_spinlock_unlock(&g_neigh_lock);
+
+    return waiters;
+}
+
+/* unicast next hop resolved by the shared table, others go through etharp of the stack */
+static err_t eth_dev_ip4_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+    const ip4_addr_t *next_hop = ipaddr;
+    struct eth_addr dst;
+    uint32_t age;
+
+    if (ip4_addr_isbroadcast(ipaddr, netif) || ip4_addr_ismulticast(ipaddr)) {
+        return etharp_output(netif, p, ipaddr);
+    }
+
+    if (!ip4_addr_netcmp(ipaddr, netif_ip4_addr(netif), netif_ip4_netmask(netif)) &&
+        !ip4_addr_islinklocal(ipaddr)) {
+        if (ip4_addr_isany(netif_ip4_gw(netif))) {
+            return etharp_output(netif, p, ipaddr);
+        }
+        next_hop = netif_ip4_gw(netif);
+    }
+
+    if (unlikely(!neigh_lookup(ip4_addr_get_u32(next_hop), &dst, &age))) {
+        neigh_add_waiter(ip4_addr_get_u32(next_hop), get_protocol_stack()->stack_idx);
+        return etharp_output(netif, p, ipaddr);
+    }
+    if (unlikely(age >= NEIGH_REFRESH_AGE_MS) && neigh_refresh_claim(ip4_addr_get_u32(next_hop))) {
+        (void)etharp_request(netif, next_hop);
+    }
+
+    return ethernet_output(netif, p, (const struct eth_addr *)netif->hwaddr, &dst, ETHTYPE_IP);
+}
+
+/* protocol stack thread receiving arp/nd packet copies it to the stacks in stack_mask,
+ * so that they can have the neighbor table */
+static void stack_broadcast_arp(struct rte_mbuf *mbuf, struct protocol_stack *cur_stack, uint32_t stack_mask)
 {
     struct protocol_stack_group *stack_group = get_protocol_stack_group();
     struct rte_mbuf *mbuf_copy = NULL;
@@ -54,7 +296,7 @@ static void stack_broadcast_arp(struct rte_mbuf *mbuf, struct protocol_stack *cu
 
     for (int32_t i = 0; i < stack_group->stack_num; i++) {
         stack = stack_group->stacks[i];
-        if (cur_stack == stack) {
+        if (cur_stack == stack || !(stack_mask & (1U << i))) {
             continue;
         }
 
@@ -88,6 +330,12 @@ static void stack_broadcast_arp(struct rte_mbuf *mbuf, struct protocol_stack *cu
     }
 #endif
     if (get_global_cfg_params()->flow_bifurcation) {
+        /* lwip only reads arp, share the mbuf with tap instead of copying; flushed after eth_dev_recv */
+        if (IS_ARP_PKT(mbuf->packet_type) && mbuf->nb_segs == 1) {
+            rte_mbuf_refcnt_update(mbuf, 1);
+            virtio_tap_process_tx(cur_stack->queue_id, mbuf);
+            return;
+        }
         ret = dpdk_alloc_pktmbuf(cur_stack->rxtx_mbuf_pool, &mbuf_copy, 1, true);
         if (ret != 0) {
             cur_stack->stats.rx_allocmbuf_fail++;
@@ -114,6 +362,9 @@ void eth_dev_recv(struct rte_mbuf *mbuf, struct protocol_stack *stack)
     pkt_len = (uint16_t)rte_pktmbuf_pkt_len(m);
 
     while (m != NULL) {
+        if (m->next != NULL) {
+            rte_prefetch0(mbuf_to_pbuf(m->next));
+        }
         len = (uint16_t)rte_pktmbuf_data_len(m);
         payload = rte_pktmbuf_mtod(m, void *);
         pc = mbuf_to_pbuf(m);
@@ -188,29 +439,6 @@ void kni_handle_tx(struct rte_mbuf *mbuf)
 }
 #endif
 
-#define IS_ARP_PKT(ptype) ((ptype & RTE_PTYPE_L2_ETHER_ARP) == RTE_PTYPE_L2_ETHER_ARP)
-#define IS_IPV4_TCP_PKT(ptype) (RTE_ETH_IS_IPV4_HDR(ptype) && \
-        ((ptype & RTE_PTYPE_L4_TCP) == RTE_PTYPE_L4_TCP) && \
-        ((ptype & RTE_PTYPE_L4_FRAG) != RTE_PTYPE_L4_FRAG) && \
-        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
-
-#define IS_IPV6_TCP_PKT(ptype) (RTE_ETH_IS_IPV6_HDR(ptype) && \
-        ((ptype & RTE_PTYPE_L4_TCP) == RTE_PTYPE_L4_TCP) && \
-        ((ptype & RTE_PTYPE_L4_FRAG) != RTE_PTYPE_L4_FRAG) && \
-        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
-
-#define IS_IPV4_UDP_PKT(ptype) (RTE_ETH_IS_IPV4_HDR(ptype) && \
-        ((ptype & RTE_PTYPE_L4_UDP) == RTE_PTYPE_L4_UDP) && \
-        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
-
-#define IS_IPV6_UDP_PKT(ptype) (RTE_ETH_IS_IPV6_HDR(ptype) && \
-        ((ptype & RTE_PTYPE_L4_UDP) == RTE_PTYPE_L4_UDP) && \
-        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
-
-#define IS_ICMPV6_PKT(ptype) (RTE_ETH_IS_IPV6_HDR(ptype) && \
-        ((ptype & RTE_PTYPE_L4_ICMP) == RTE_PTYPE_L4_ICMP) && \
-        (RTE_ETH_IS_TUNNEL_PKT(ptype) == 0))
-
 static uint16_t eth_dev_get_dst_port(struct rte_mbuf *pkt)
 {
     uint16_t dst_port = VIRTIO_PORT_INVALID;
@@ -226,11 +454,366 @@ static uint16_t eth_dev_get_dst_port(struct rte_mbuf *pkt)
     return dst_port;
 }
 
+struct steer_key {
+    uint32_t src_addr[4];
+    uint32_t dst_addr[4];
+    uint16_t src_port;
+    uint16_t dst_port;
+};
+
+struct steer_flow {
+    struct steer_key key;
+    uint32_t last_ms;
+    uint8_t used;
+    uint8_t closing;
+    uint8_t stack_idx;
+};
+
+/* listen_reuseport state owned by one stack thread */
+struct eth_steer {
+    /* packets handed to each stack in this poll, chained by eth_dev_pkt_next */
+    struct rte_mbuf *head[PROTOCOL_STACK_MAX];
+    struct rte_mbuf *tail[PROTOCOL_STACK_MAX];
+    uint32_t cnt[PROTOCOL_STACK_MAX];
+    struct steer_flow flows[STEER_FLOW_TBL_SIZE];
+};
+
+/* the pbuf area of an rx mbuf is set up only by eth_dev_recv, until then it links steered packets */
+static inline struct rte_mbuf **eth_dev_pkt_next(struct rte_mbuf *m)
+{
+    return (struct rte_mbuf **)mbuf_to_pbuf(m);
+}
+
+void eth_dev_recv_list(struct rte_mbuf *mbuf, struct protocol_stack *stack)
+{
+    while (mbuf != NULL) {
+        struct rte_mbuf *next = *eth_dev_pkt_next(mbuf);
+        eth_dev_recv(mbuf, stack);
+        mbuf = next;
+    }
+}
+
+static struct steer_flow *steer_flow_lookup(struct eth_steer *steer, const struct steer_key *key, uint32_t hash)
+{
+    for (uint32_t i = 0; i < STEER_FLOW_TBL_PROBE; i++) {
+        struct steer_flow *flow = &steer->flows[(hash + i) & (STEER_FLOW_TBL_SIZE - 1)];
+        if (flow->used && memcmp(&flow->key, key, sizeof(*key)) == 0) {
+            return flow;
+        }
+    }
+    return NULL;
+}
+
+static struct steer_flow *steer_flow_insert(struct eth_steer *steer, const struct steer_key *key, uint32_t hash,
+    uint32_t now)
+{
+    for (uint32_t i = 0; i < STEER_FLOW_TBL_PROBE; i++) {
+        struct steer_flow *flow = &steer->flows[(hash + i) & (STEER_FLOW_TBL_SIZE - 1)];
+        if (flow->used && (!flow->closing || now - flow->last_ms < STEER_FLOW_CLOSE_MS)) {
+            continue;
+        }
+        flow->key = *key;
+        flow->used = 1;
+        flow->closing = 0;
+        return flow;
+    }
+    return NULL;
+}
+
+static void steer_key_init(struct steer_key *key, const struct rte_mbuf *mbuf, const struct rte_tcp_hdr *tcp_hdr)
+{
+    const void *l3_hdr = rte_pktmbuf_mtod_offset(mbuf, void *, mbuf->l2_len);
+
+    (void)memset_s(key, sizeof(*key), 0, sizeof(*key));
+    if (RTE_ETH_IS_IPV4_HDR(mbuf->packet_type)) {
+        key->src_addr[0] = ((const struct rte_ipv4_hdr *)l3_hdr)->src_addr;
+        key->dst_addr[0] = ((const struct rte_ipv4_hdr *)l3_hdr)->dst_addr;
+    } else {
+        const struct rte_ipv6_hdr *ip6_hdr = l3_hdr;
+        (void)memcpy_s(key->src_addr, sizeof(key->src_addr), ip6_hdr->src_addr, sizeof(ip6_hdr->src_addr));
+        (void)memcpy_s(key->dst_addr, sizeof(key->dst_addr), ip6_hdr->dst_addr, sizeof(ip6_hdr->dst_addr));
+    }
+    key->src_port = tcp_hdr->src_port;
+    key->dst_port = tcp_hdr->dst_port;
+}
+
+/*
+ * listen_reuseport: a syn to a port with no listener on current stack is handed to a listening stack
+ * chosen by tuple hash, and the choice is kept in the flow table, so listen and close on any stack never
+ * move an established flow. when the probe window is full of live flows the syn is placed by the hash
+ * alone, and segments of flows not in the table follow the same hash. they stay here if current stack
+ * listens on the port or has closed a listener on it, then they belong to a local pcb.
+ */
+static int eth_dev_reuseport_steer(struct rte_mbuf *mbuf, struct protocol_stack *stack)
+{
+    struct eth_steer *steer = stack->steer;
+    uint32_t packet_type = mbuf->packet_type;
+    struct steer_flow *flow;
+    struct steer_key key;
+
+    if (!IS_IPV4_TCP_PKT(packet_type) && !IS_IPV6_TCP_PKT(packet_type)) {
+        return TRANSFER_CURRENT_THREAD;
+    }
+
+    const struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(mbuf, struct rte_tcp_hdr *,
+        mbuf->l2_len + mbuf->l3_len);
+    uint8_t flags = tcp_hdr->tcp_flags;
+    uint32_t now = sys_now();
+
+    steer_key_init(&key, mbuf, tcp_hdr);
+    uint32_t hash = rte_jhash(&key, sizeof(key), 0);
+    uint16_t port = rte_be_to_cpu_16(tcp_hdr->dst_port);
+    flow = steer_flow_lookup(steer, &key, hash);
+    int stack_idx = (flow != NULL) ? flow->stack_idx : -1;
+
+    if ((flags & (RTE_TCP_SYN_FLAG | RTE_TCP_ACK_FLAG)) == RTE_TCP_SYN_FLAG) {
+        /* a retransmitted syn goes where the first one went, a reused tuple is placed again */
+        if (flow == NULL || flow->closing) {
+            stack_idx = stack_reuseport_select(port, hash, stack->stack_idx);
+            if (stack_idx < 0) {
+                if (flow != NULL) {
+                    flow->used = 0;
+                }
+                return TRANSFER_CURRENT_THREAD;
+            }
+            if (flow == NULL) {
+                flow = steer_flow_insert(steer, &key, hash, now);
+            }
+            if (flow != NULL) {
+                flow->closing = 0;
+                flow->stack_idx = (uint8_t)stack_idx;
+            }
+        }
+    } else if (flow == NULL) {
+        if (stack_reuseport_left(port, stack->stack_idx)) {
+            return TRANSFER_CURRENT_THREAD;
+        }
+        stack_idx = stack_reuseport_select(port, hash, stack->stack_idx);
+        if (stack_idx < 0) {
+            return TRANSFER_CURRENT_THREAD;
+        }
+    } else if (flags & (RTE_TCP_FIN_FLAG | RTE_TCP_RST_FLAG)) {
+        flow->closing = 1;
+    }
+    if (flow != NULL) {
+        flow->last_ms = now;
+    }
+
+    *eth_dev_pkt_next(mbuf) = NULL;
+    if (steer->head[stack_idx] == NULL) {
+        steer->head[stack_idx] = mbuf;
+    } else {
+        *eth_dev_pkt_next(steer->tail[stack_idx]) = mbuf;
+    }
+    steer->tail[stack_idx] = mbuf;
+    steer->cnt[stack_idx]++;
+    return TRANSFER_OTHER_THREAD;
+}
+
+/* one rpc per target stack for the packets steered in this poll */
+static void eth_dev_steer_flush(struct protocol_stack *stack)
+{
+    struct eth_steer *steer = stack->steer;
+    struct protocol_stack_group *stack_group = get_protocol_stack_group();
+
+    for (uint16_t i = 0; i < stack_group->stack_num; i++) {
+        struct rte_mbuf *mbuf = steer->head[i];
+        if (mbuf == NULL) {
+            continue;
+        }
+
+        if (rpc_call_pkts(&stack_group->stacks[i]->rpc_queue, mbuf) != 0) {
+            stack->stats.rx_drop += steer->cnt[i];
+            while (mbuf != NULL) {
+                struct rte_mbuf *next = *eth_dev_pkt_next(mbuf);
+                rte_pktmbuf_free(mbuf);
+                mbuf = next;
+            }
+        }
+        steer->head[i] = NULL;
+        steer->tail[i] = NULL;
+        steer->cnt[i] = 0;
+    }
+}
+
+/* syn_watermark: a new syn is freed here under pressure, so a flood costs no pcb or socket */
+static bool eth_dev_syn_drop(struct rte_mbuf *pkt, struct protocol_stack *stack)
+{
+    if (!IS_IPV4_TCP_PKT(pkt->packet_type) && !IS_IPV6_TCP_PKT(pkt->packet_type)) {
+        return false;
+    }
+
+    const struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(pkt, struct rte_tcp_hdr *,
+        pkt->l2_len + pkt->l3_len);
+    if ((tcp_hdr->tcp_flags & (RTE_TCP_SYN_FLAG | RTE_TCP_ACK_FLAG)) != RTE_TCP_SYN_FLAG) {
+        return false;
+    }
+
+    gz_addr_t local_ip = {0};
+    if (IS_IPV4_TCP_PKT(pkt->packet_type)) {
+        const struct rte_ipv4_hdr *iph = rte_pktmbuf_mtod_offset(pkt, struct rte_ipv4_hdr *, pkt->l2_len);
+        local_ip.type = IPADDR_TYPE_V4;
+        local_ip.u_addr.ip4.addr = iph->dst_addr;
+    } else {
+        const struct rte_ipv6_hdr *iph6 = rte_pktmbuf_mtod_offset(pkt, struct rte_ipv6_hdr *, pkt->l2_len);
+        local_ip.type = IPADDR_TYPE_V6;
+        memcpy_s(local_ip.u_addr.ip6.addr, IPV6_ADDR_LEN, iph6->dst_addr, IPV6_ADDR_LEN);
+    }
+    if (!do_lwip_syn_overload(stack, &local_ip, rte_be_to_cpu_16(tcp_hdr->dst_port))) {
+        return false;
+    }
+
+    stack->stats.syn_drop++;
+    rte_pktmbuf_free(pkt);
+    return true;
+}
+
+/* 1 current thread recv; 0 other thread recv; -1 kni recv; */
+static inline int eth_dev_classify(struct rte_mbuf *pkt, struct protocol_stack *stack)
+{
+    int transfer_type = TRANSFER_CURRENT_THREAD;
+
+    if (use_ltran()) {
+        return transfer_type;
+    }
+
+    /* copy arp into other stack */
+    if (unlikely(IS_ARP_PKT(pkt->packet_type)) || unlikely(IS_ICMPV6_PKT(pkt->packet_type))) {
+        /* arp is shared through neighbor table, only stacks still resolving need the packet */
+        uint32_t stack_mask = IS_ARP_PKT(pkt->packet_type) ? neigh_learn(pkt, stack) : NEIGH_ALL_STACKS;
+        stack_broadcast_arp(pkt, stack, stack_mask);
+        /* copy arp into other process */
+        transfer_arp_to_other_process(pkt);
+        return transfer_type;
+    }
+
+    if (get_global_cfg_params()->tuple_filter && stack->queue_id == 0) {
+        transfer_type = distribute_pakages(pkt);
+    } else if (get_global_cfg_params()->listen_reuseport) {
+        transfer_type = eth_dev_reuseport_steer(pkt, stack);
+    }
+    /* packets handed to other thread are not owned by current thread any more */
+    if (get_global_cfg_params()->flow_bifurcation && transfer_type == TRANSFER_CURRENT_THREAD) {
+        uint16_t dst_port = eth_dev_get_dst_port(pkt);
+        if (virtio_distribute_pkg_to_kernel(dst_port)) {
+            transfer_type = TRANSFER_KERNEL;
+        }
+    }
+    /* dropped packets are not owned by current thread any more either */
+    if (get_global_cfg_params()->syn_watermark != 0 && transfer_type == TRANSFER_CURRENT_THREAD &&
+        unlikely(eth_dev_syn_drop(pkt, stack))) {
+        transfer_type = TRANSFER_OTHER_THREAD;
+    }
+    return transfer_type;
+}
+
+static inline void eth_dev_deliver(struct rte_mbuf *pkt, int transfer_type, struct protocol_stack *stack)
+{
+    if (likely(transfer_type == TRANSFER_CURRENT_THREAD)) {
+        eth_dev_recv(pkt, stack);
+    } else if (transfer_type == TRANSFER_KERNEL) {
+        if (get_global_cfg_params()->flow_bifurcation) {
+            virtio_tap_process_tx(stack->queue_id, pkt);
+        } else {
+#if RTE_VERSION < RTE_VERSION_NUM(23, 11, 0, 0)
+            kni_handle_tx(pkt);
+#else
+            rte_pktmbuf_free(pkt);
+#endif
+        }
+    } else {
+        /* transfer to other thread */
+    }
+}
+
+/* eth_dev_recv writes the pbuf_custom in mbuf_private and unlinks m->next, lwip reads the headers */
+static inline void eth_dev_recv_prefetch(struct rte_mbuf *pkt)
+{
+    rte_prefetch0(mbuf_to_pbuf(pkt));
+    rte_prefetch0(&pkt->next);
+    rte_prefetch0(rte_pktmbuf_mtod(pkt, void *));
+}
+
+static inline uint32_t eth_dev_flow_hash(const struct rte_mbuf *pkt)
+{
+    if (pkt->ol_flags & RTE_MBUF_F_RX_RSS_HASH) {
+        return pkt->hash.rss;
+    }
+
+    const void *l3_hdr = rte_pktmbuf_mtod_offset(pkt, void *, pkt->l2_len);
+    const struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(pkt, struct rte_tcp_hdr *,
+        pkt->l2_len + pkt->l3_len);
+    uint32_t ports = ((uint32_t)tcp_hdr->src_port << 16) | tcp_hdr->dst_port;
+
+    if (RTE_ETH_IS_IPV4_HDR(pkt->packet_type)) {
+        const struct rte_ipv4_hdr *iph = l3_hdr;
+        return rte_jhash_3words(iph->src_addr, iph->dst_addr, ports, 0);
+    }
+    const struct rte_ipv6_hdr *iph6 = l3_hdr;
+    /* src_addr and dst_addr are adjacent */
+    return rte_jhash(&iph6->src_addr, sizeof(iph6->src_addr) + sizeof(iph6->dst_addr), ports);
+}
+
+/*
+ * stable grouping of tcp segments kept by current stack: segments of one flow are delivered
+ * right after the first one of the flow, in their original order, so lwip finds the same pcb
+ * and connection state hot for the whole group. other packets keep their place.
+ */
+static void eth_dev_flow_group(struct rte_mbuf **pkts, const int8_t *transfer, uint32_t num, uint8_t *order)
+{
+    uint8_t tbl[RX_FLOW_TBL_SIZE];
+    uint32_t hash[RX_FLOW_GROUP_MAX];
+    uint8_t next[RX_FLOW_GROUP_MAX];
+    uint8_t tail[RX_FLOW_GROUP_MAX];
+    bool head[RX_FLOW_GROUP_MAX];
+
+    (void)memset_s(tbl, sizeof(tbl), RX_FLOW_GROUP_NONE, sizeof(tbl));
+
+    for (uint32_t i = 0; i < num; i++) {
+        next[i] = RX_FLOW_GROUP_NONE;
+        head[i] = true;
+        if (transfer[i] != TRANSFER_CURRENT_THREAD ||
+            (!IS_IPV4_TCP_PKT(pkts[i]->packet_type) && !IS_IPV6_TCP_PKT(pkts[i]->packet_type))) {
+            continue;
+        }
+
+        hash[i] = eth_dev_flow_hash(pkts[i]);
+        for (uint32_t probe = 0; probe < RX_FLOW_TBL_PROBE; probe++) {
+            uint8_t *slot = &tbl[(hash[i] + probe) & (RX_FLOW_TBL_SIZE - 1)];
+            if (*slot == RX_FLOW_GROUP_NONE) {
+                *slot = (uint8_t)i;
+                tail[i] = (uint8_t)i;
+                break;
+            }
+            if (hash[*slot] == hash[i]) {
+                next[tail[*slot]] = (uint8_t)i;
+                tail[*slot] = (uint8_t)i;
+                head[i] = false;
+                break;
+            }
+        }
+    }
+
+    uint32_t cnt = 0;
+    for (uint32_t i = 0; i < num; i++) {
+        for (uint8_t j = head[i] ? (uint8_t)i : RX_FLOW_GROUP_NONE; j != RX_FLOW_GROUP_NONE; j = next[j]) {
+            order[cnt++] = j;
+        }
+    }
+}
+
+/*
+ * the burst goes through two stages, so the memory each stage touches is prefetched
+ * RX_PREFETCH_OFFSET packets ahead instead of being missed packet by packet:
+ * 1. classify: arp broadcast and steering to other stacks, kernel or current stack.
+ * 2. deliver: packets kept by current stack are handed to lwip, grouped by flow.
+ */
 int32_t eth_dev_poll(void)
 {
     uint32_t nr_pkts;
     struct cfg_params *cfg = get_global_cfg_params();
     struct protocol_stack *stack = get_protocol_stack();
+    int8_t transfer[NIC_QUEUE_SIZE_MAX];
 
     nr_pkts = stack->dev_ops.rx_poll(stack, stack->pkts, cfg->nic_read_number);
     if (nr_pkts == 0) {
@@ -242,44 +825,49 @@ int32_t eth_dev_poll(void)
         time_stamp_into_mbuf(nr_pkts, stack->pkts, time_stamp);
     }
 
+    for (uint32_t i = 0; i < LWIP_MIN(nr_pkts, RX_PREFETCH_OFFSET); i++) {
+        rte_prefetch0(rte_pktmbuf_mtod(stack->pkts[i], void *));
+    }
     for (uint32_t i = 0; i < nr_pkts; i++) {
-        /* 1 current thread recv; 0 other thread recv; -1 kni recv; */
-        int transfer_type = TRANSFER_CURRENT_THREAD;
-        /* copy arp into other stack */
-        if (!use_ltran()) {
-            if (unlikely(IS_ARP_PKT(stack->pkts[i]->packet_type)) ||
-                unlikely(IS_ICMPV6_PKT(stack->pkts[i]->packet_type))) {
-                stack_broadcast_arp(stack->pkts[i], stack);
-                /* copy arp into other process */
-                transfer_arp_to_other_process(stack->pkts[i]);
-            } else {
-                if (get_global_cfg_params()->tuple_filter && stack->queue_id == 0) {
-                    transfer_type = distribute_pakages(stack->pkts[i]);
-                }
-                if (get_global_cfg_params()->flow_bifurcation) {
-                    uint16_t dst_port = eth_dev_get_dst_port(stack->pkts[i]);
-                    if (virtio_distribute_pkg_to_kernel(dst_port)) {
-                        transfer_type = TRANSFER_KERNEL;
-                    }
-                }
-            }
+        if (i + RX_PREFETCH_OFFSET < nr_pkts) {
+            rte_prefetch0(rte_pktmbuf_mtod(stack->pkts[i + RX_PREFETCH_OFFSET], void *));
         }
+        transfer[i] = (int8_t)eth_dev_classify(stack->pkts[i], stack);
+    }
 
-        if (likely(transfer_type == TRANSFER_CURRENT_THREAD)) {
-            eth_dev_recv(stack->pkts[i], stack);
-        } else if (transfer_type == TRANSFER_KERNEL) {
-            if (get_global_cfg_params()->flow_bifurcation) {
-                virtio_tap_process_tx(stack->queue_id, stack->pkts[i]);
-            } else {
-#if RTE_VERSION < RTE_VERSION_NUM(23, 11, 0, 0)
-                kni_handle_tx(stack->pkts[i]);
-#else
-                rte_pktmbuf_free(stack->pkts[i]);
-#endif
+    for (uint32_t base = 0; base < nr_pkts; base += RX_FLOW_GROUP_MAX) {
+        struct rte_mbuf **pkts = &stack->pkts[base];
+        const int8_t *types = &transfer[base];
+        uint32_t num = LWIP_MIN(nr_pkts - base, RX_FLOW_GROUP_MAX);
+        uint8_t order[RX_FLOW_GROUP_MAX];
+
+        if (use_ltran()) {
+            for (uint32_t i = 0; i < num; i++) {
+                order[i] = (uint8_t)i;
             }
         } else {
-            /* transfer to other thread */
+            eth_dev_flow_group(pkts, types, num, order);
+        }
+
+        for (uint32_t i = 0; i < LWIP_MIN(num, RX_PREFETCH_OFFSET); i++) {
+            if (types[order[i]] == TRANSFER_CURRENT_THREAD) {
+                eth_dev_recv_prefetch(pkts[order[i]]);
+            }
         }
+        for (uint32_t i = 0; i < num; i++) {
+            if (i + RX_PREFETCH_OFFSET < num && types[order[i + RX_PREFETCH_OFFSET]] == TRANSFER_CURRENT_THREAD) {
+                eth_dev_recv_prefetch(pkts[order[i + RX_PREFETCH_OFFSET]]);
+            }
+            eth_dev_deliver(pkts[order[i]], types[order[i]], stack);
+        }
+    }
+
+    if (stack->steer != NULL) {
+        eth_dev_steer_flush(stack);
+    }
+
+    if (get_global_cfg_params()->flow_bifurcation) {
+        virtio_tap_flush_tx(stack->queue_id);
     }
 
     stack->stats.rx += nr_pkts;
@@ -294,6 +882,14 @@ static err_t eth_dev_output(struct netif *netif, struct pbuf *pbuf)
     struct rte_mbuf *first_mbuf = NULL;
     void *buf_addr;
 
+    /*
+     * a retransmitted segment may still wait in tx backlog, rewriting its mbuf would corrupt the queued copy.
+     * a copy already in the nic ring is only read by dma before completion, far within the tcp rto.
+     */
+    if (unlikely(vdev_tx_pending(stack->stack_idx) != 0) && vdev_tx_backlogged(pbuf)) {
+        return ERR_MEM;
+    }
+
     while (likely(pbuf != NULL)) {
         struct rte_mbuf *mbuf = pbuf_to_mbuf(pbuf);
 
@@ -351,7 +947,7 @@ static err_t eth_dev_init(struct netif *netif)
     netif->name[1] = 't';
     netif->flags |= NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_IGMP | NETIF_FLAG_MLD6;
     netif->mtu = FRAME_MTU;
-    netif->output = etharp_output;
+    netif->output = eth_dev_ip4_output;
     netif->linkoutput = eth_dev_output;
     netif->output_ip6 = ethip6_output;
 
@@ -372,7 +968,7 @@ static err_t eth_dev_init(struct netif *netif)
         /* 16: see kernel MAX_SKB_FRAGS define in skbuff.h */
         netif_set_max_pbuf_frags(netif, 16);
     } else {
-        netif_set_rxol_flags(netif, get_protocol_stack_group()->rx_offload);
+        netif_set_rxol_flags(netif, get_protocol_stack_group()->rx_offload | dpdk_sw_rx_cksum_ol());
         netif_set_txol_flags(netif, get_protocol_stack_group()->tx_offload);
         /* 40: dpdk pmd support 40 max segs */
         netif_set_max_pbuf_frags(netif, 40);
@@ -410,6 +1006,17 @@ int32_t ethdev_init(struct protocol_stack *stack)
         if (cfg->tuple_filter && stack->queue_id == 0) {
             flow_init();
         }
+        /* stack thread runs on its numa node, the table is node local */
+        if (cfg->listen_reuseport) {
+            stack->steer = calloc(1, sizeof(struct eth_steer));
+            if (stack->steer == NULL) {
+                LSTACK_LOG(ERR, LSTACK, "stack %u alloc reuseport flow table failed\n", stack->stack_idx);
+                return -1;
+            }
+        }
+        if (vdev_gro_init(stack) != 0) {
+            return -1;
+        }
     }
 
     netif_set_default(&stack->netif);
@@ -441,3 +1048,10 @@ int32_t ethdev_init(struct protocol_stack *stack)
 
     return 0;
 }
+
+void ethdev_exit(struct protocol_stack *stack)
+{
+    free(stack->steer);
+    stack->steer = NULL;
+    vdev_gro_exit(stack);
+}
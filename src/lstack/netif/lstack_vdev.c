@@ -20,6 +20,8 @@
 #include <rte_ethdev.h>
 #include <rte_gro.h>
 #include <rte_net.h>
+#include <rte_ip.h>
+#include <rte_prefetch.h>
 #include <netif/ethernet.h>
 
 #include <lwip/dpdk_version.h>
@@ -46,6 +48,10 @@
  * more, means less available mbuf.
  */
 #define INUSE_TX_PKTS_WATERMARK         (VDEV_TX_QUEUE_SZ >> 2)
+#define VDEV_TX_BACKLOG_SIZE            512
+#define VDEV_TX_BACKLOG_MASK            (VDEV_TX_BACKLOG_SIZE - 1)
+/* far below tcp min rto, so a segment still in backlog is never rewritten by a rto retransmit */
+#define VDEV_TX_BACKLOG_HOLD_MS         100
 #define USED_RX_PKTS_WATERMARK          (FREE_RX_QUEUE_SZ >> 2)
 
 #define IPV4_MASK                       (0xf0)
@@ -76,125 +82,435 @@ static uint32_t ltran_rx_poll(struct protocol_stack *stack, struct rte_mbuf **pk
     return rcvd_pkts;
 }
 
+static void vdev_pkt_parse_sw(struct rte_mbuf *m)
+{
+    struct rte_ether_hdr *ethh = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    u16_t type  = ethh->ether_type;
+    if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
+        struct rte_vlan_hdr *vlan = (struct rte_vlan_hdr *)(ethh + 1);
+        type = vlan->eth_proto;
+        m->l2_len = sizeof(struct rte_ether_hdr) + sizeof(struct rte_vlan_hdr);
+    } else {
+        m->l2_len = sizeof(struct rte_ether_hdr);
+    }
+
+    m->packet_type = 0;
+    if (type == RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
+        struct rte_ipv4_hdr *iph = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, m->l2_len);
+        if (unlikely((iph->version_ihl & IPV4_MASK) != IPV4_VERION)) {
+            return;
+        }
+        m->l3_len = sizeof(struct rte_ipv4_hdr);
+        if (iph->next_proto_id == IPPROTO_TCP) {
+            struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(m, struct rte_tcp_hdr *,
+                m->l2_len + m->l3_len);
+            m->l4_len = TCP_HDR_LEN(tcp_hdr);
+
+            m->packet_type = RTE_PTYPE_L3_IPV4 | RTE_PTYPE_L4_TCP;
+        } else if (iph->next_proto_id == IPPROTO_UDP) {
+            m->l4_len = sizeof(struct rte_udp_hdr);
+            m->packet_type = RTE_PTYPE_L3_IPV4 | RTE_PTYPE_L4_UDP;
+        }
+
+    } else if (type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
+        struct rte_ipv6_hdr *iph6 = rte_pktmbuf_mtod_offset(m, struct rte_ipv6_hdr *, m->l2_len);
+        m->l3_len = sizeof(struct rte_ipv6_hdr);
+        if (iph6->proto == IPPROTO_TCP) {
+            struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(m, struct rte_tcp_hdr *,
+                m->l2_len + m->l3_len);
+            m->l4_len = TCP_HDR_LEN(tcp_hdr);
+            m->packet_type = RTE_PTYPE_L3_IPV6 | RTE_PTYPE_L4_TCP;
+        } else if (iph6->proto == IPPROTO_UDP) {
+            m->l4_len = sizeof(struct rte_udp_hdr);
+            m->packet_type = RTE_PTYPE_L3_IPV6 | RTE_PTYPE_L4_UDP;
+        } else if (iph6->proto == IPPROTO_ICMPV6) {
+            m->packet_type = RTE_PTYPE_L3_IPV6 | RTE_PTYPE_L4_ICMP;
+        }
+    } else if (type == RTE_BE16(RTE_ETHER_TYPE_ARP)) {
+        m->packet_type = RTE_PTYPE_L2_ETHER_ARP;
+    }
+}
+
+/*
+ * trust the ptype the nic has classified: only tcp/udp over ipv4 and over ipv6 without extension
+ * headers and arp are taken, and reduced to the same packet_type vdev_pkt_parse_sw sets.
+ * the rest goes to the software parser.
+ */
+static inline bool vdev_pkt_parse_hw(struct rte_mbuf *m)
+{
+    uint32_t ptype = m->packet_type;
+    uint32_t l2_type = ptype & RTE_PTYPE_L2_MASK;
+    uint32_t l3_type = ptype & RTE_PTYPE_L3_MASK;
+    uint32_t l4_type = ptype & RTE_PTYPE_L4_MASK;
+
+    if (RTE_ETH_IS_TUNNEL_PKT(ptype) ||
+        (l2_type != RTE_PTYPE_L2_ETHER && l2_type != RTE_PTYPE_L2_ETHER_VLAN && l2_type != RTE_PTYPE_L2_ETHER_ARP)) {
+        return false;
+    }
+
+    /* vlan may have been stripped whatever l2_type says, the ether type is authoritative */
+    struct rte_ether_hdr *ethh = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    m->l2_len = (ethh->ether_type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) ?
+        sizeof(struct rte_ether_hdr) + sizeof(struct rte_vlan_hdr) : sizeof(struct rte_ether_hdr);
+
+    if (l2_type == RTE_PTYPE_L2_ETHER_ARP) {
+        m->packet_type = RTE_PTYPE_L2_ETHER_ARP;
+        return true;
+    }
+    if (l4_type != RTE_PTYPE_L4_TCP && l4_type != RTE_PTYPE_L4_UDP) {
+        return false;
+    }
+
+    if (l3_type == RTE_PTYPE_L3_IPV4 || l3_type == RTE_PTYPE_L3_IPV4_EXT ||
+        l3_type == RTE_PTYPE_L3_IPV4_EXT_UNKNOWN) {
+        /* _EXT may carry options, many nics report _EXT_UNKNOWN for every ipv4 packet */
+        struct rte_ipv4_hdr *iph = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, m->l2_len);
+        m->l3_len = (iph->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+        m->packet_type = RTE_PTYPE_L3_IPV4 | l4_type;
+    } else if (l3_type == RTE_PTYPE_L3_IPV6) {
+        m->l3_len = sizeof(struct rte_ipv6_hdr);
+        m->packet_type = RTE_PTYPE_L3_IPV6 | l4_type;
+    } else {
+        return false;
+    }
+
+    if (l4_type == RTE_PTYPE_L4_TCP) {
+        struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(m, struct rte_tcp_hdr *, m->l2_len + m->l3_len);
+        m->l4_len = TCP_HDR_LEN(tcp_hdr);
+    } else {
+        m->l4_len = sizeof(struct rte_udp_hdr);
+    }
+    return true;
+}
+
 static inline void vdev_pkts_parse(struct rte_mbuf **pkts, int pkt_num)
 {
+    if (!get_protocol_stack_group()->rx_ptype_hw) {
+        for (int i = 0; i < pkt_num; i++) {
+            vdev_pkt_parse_sw(pkts[i]);
+        }
+        return;
+    }
+
     for (int i = 0; i < pkt_num; i++) {
-        struct rte_ether_hdr *ethh = rte_pktmbuf_mtod(pkts[i], struct rte_ether_hdr *);
-        u16_t type  = ethh->ether_type;
-        if (type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
-            struct rte_vlan_hdr *vlan = (struct rte_vlan_hdr *)(ethh + 1);
-            type = vlan->eth_proto;
-            pkts[i]->l2_len = sizeof(struct rte_ether_hdr) + sizeof(struct rte_vlan_hdr);
-        } else {
-            pkts[i]->l2_len = sizeof(struct rte_ether_hdr);
+        if (unlikely(!vdev_pkt_parse_hw(pkts[i]))) {
+            vdev_pkt_parse_sw(pkts[i]);
         }
+    }
+}
 
-        pkts[i]->packet_type = 0;
-        if (type == RTE_BE16(RTE_ETHER_TYPE_IPV4)) {
-            struct rte_ipv4_hdr *iph = rte_pktmbuf_mtod_offset(pkts[i], struct rte_ipv4_hdr *,
-                pkts[i]->l2_len);
-            if (unlikely((iph->version_ihl & IPV4_MASK) != IPV4_VERION)) {
-                continue;
-            }
-            pkts[i]->l3_len = sizeof(struct rte_ipv4_hdr);
-            if (iph->next_proto_id == IPPROTO_TCP) {
-                struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(pkts[i], struct rte_tcp_hdr *,
-                    pkts[i]->l2_len + pkts[i]->l3_len);
-                pkts[i]->l4_len = TCP_HDR_LEN(tcp_hdr);
-
-                pkts[i]->packet_type = RTE_PTYPE_L3_IPV4 | RTE_PTYPE_L4_TCP;
-            } else if (iph->next_proto_id == IPPROTO_UDP) {
-                pkts[i]->l4_len = sizeof(struct rte_udp_hdr);
-                pkts[i]->packet_type = RTE_PTYPE_L3_IPV4 | RTE_PTYPE_L4_UDP;
-            }
+static inline bool vdev_l4_cksum_ok(struct rte_mbuf *m, uint32_t l4_off, uint32_t l4_len, uint16_t phdr_cksum)
+{
+    uint16_t raw;
 
-        } else if (type == RTE_BE16(RTE_ETHER_TYPE_IPV6)) {
-            struct rte_ipv6_hdr *iph6 = rte_pktmbuf_mtod_offset(pkts[i], struct rte_ipv6_hdr *,
-                pkts[i]->l2_len);
-            pkts[i]->l3_len = sizeof(struct rte_ipv6_hdr);
-            if (iph6->proto == IPPROTO_TCP) {
-                struct rte_tcp_hdr *tcp_hdr = rte_pktmbuf_mtod_offset(pkts[i], struct rte_tcp_hdr *,
-                    pkts[i]->l2_len + pkts[i]->l3_len);
-                pkts[i]->l4_len = TCP_HDR_LEN(tcp_hdr);
-                pkts[i]->packet_type = RTE_PTYPE_L3_IPV6 | RTE_PTYPE_L4_TCP;
-            } else if (iph6->proto == IPPROTO_UDP) {
-                pkts[i]->l4_len = sizeof(struct rte_udp_hdr);
-                pkts[i]->packet_type = RTE_PTYPE_L3_IPV6 | RTE_PTYPE_L4_UDP;
-            } else if (iph6->proto == IPPROTO_ICMPV6) {
-                pkts[i]->packet_type = RTE_PTYPE_L3_IPV6 | RTE_PTYPE_L4_ICMP;
-            }
-        } else if (type == RTE_BE16(RTE_ETHER_TYPE_ARP)) {
-            pkts[i]->packet_type = RTE_PTYPE_L2_ETHER_ARP;
+    if (l4_off + l4_len > rte_pktmbuf_pkt_len(m) || rte_raw_cksum_mbuf(m, l4_off, l4_len, &raw) != 0) {
+        return false;
+    }
+    uint32_t sum = (uint32_t)raw + phdr_cksum;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return sum == 0xffff;
+}
+
+static bool vdev_pkt_cksum_ok(struct rte_mbuf *m, uint64_t sw_ol)
+{
+    uint32_t l4_type = m->packet_type & RTE_PTYPE_L4_MASK;
+    bool check_l4 = (l4_type == RTE_PTYPE_L4_TCP && (sw_ol & RTE_ETH_RX_OFFLOAD_TCP_CKSUM)) ||
+        (l4_type == RTE_PTYPE_L4_UDP && (sw_ol & RTE_ETH_RX_OFFLOAD_UDP_CKSUM));
+
+    if (RTE_ETH_IS_IPV4_HDR(m->packet_type)) {
+        struct rte_ipv4_hdr *iph = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, m->l2_len);
+        uint32_t ihl = (iph->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+        if ((sw_ol & RTE_ETH_RX_OFFLOAD_IPV4_CKSUM) && rte_raw_cksum(iph, ihl) != 0xffff) {
+            return false;
+        }
+        m->ol_flags |= RTE_MBUF_F_RX_IP_CKSUM_GOOD;
+        /* l4 cksum of a fragment covers the whole datagram, leave it as nics do */
+        if (!check_l4 || (iph->fragment_offset & RTE_BE16(RTE_IPV4_HDR_MF_FLAG | RTE_IPV4_HDR_OFFSET_MASK)) != 0) {
+            return true;
+        }
+        if (l4_type == RTE_PTYPE_L4_UDP &&
+            rte_pktmbuf_mtod_offset(m, struct rte_udp_hdr *, m->l2_len + ihl)->dgram_cksum == 0) {
+            return true;
+        }
+        if (!vdev_l4_cksum_ok(m, m->l2_len + ihl, rte_be_to_cpu_16(iph->total_length) - ihl,
+            rte_ipv4_phdr_cksum(iph, 0))) {
+            return false;
+        }
+    } else if (RTE_ETH_IS_IPV6_HDR(m->packet_type)) {
+        struct rte_ipv6_hdr *iph6 = rte_pktmbuf_mtod_offset(m, struct rte_ipv6_hdr *, m->l2_len);
+        if (!check_l4) {
+            return true;
+        }
+        if (!vdev_l4_cksum_ok(m, m->l2_len + m->l3_len, rte_be_to_cpu_16(iph6->payload_len),
+            rte_ipv6_phdr_cksum(iph6, 0))) {
+            return false;
+        }
+    } else {
+        return true;
+    }
+
+    m->ol_flags |= RTE_MBUF_F_RX_L4_CKSUM_GOOD;
+    return true;
+}
+
+/* verify in software what the nic does not, so lwip and gro can trust the burst; bad packets are dropped */
+static uint32_t vdev_pkts_cksum_verify(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t pkt_num,
+    uint64_t sw_ol)
+{
+    uint32_t num = 0;
+
+    for (uint32_t i = 0; i < pkt_num; i++) {
+        if (i + 1 < pkt_num) {
+            rte_prefetch0(rte_pktmbuf_mtod(pkts[i + 1], void *));
+        }
+        if (likely(vdev_pkt_cksum_ok(pkts[i], sw_ol))) {
+            pkts[num++] = pkts[i];
         } else {
-            continue;
+            stack->stats.rx_cksum_bad++;
+            rte_pktmbuf_free(pkts[i]);
         }
     }
+    return num;
 }
 
-static uint32_t vdev_rx_poll(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t max_mbuf)
+#ifdef RTE_GRO_TCP_IPV6
+#define VDEV_GRO_TYPES                  (RTE_GRO_TCP_IPV4 | RTE_GRO_TCP_IPV6)
+#else
+#define VDEV_GRO_TYPES                  (RTE_GRO_TCP_IPV4)
+#endif
+
+/*
+ * the burst api caps its table at RTE_GRO_MAX_BURST_ITEM_NUM items, a per-stack context
+ * lets gro_max_flow_num * gro_max_item_per_flow grow past that. it is flushed on every poll,
+ * so packets are never held across polls.
+ */
+int32_t vdev_gro_init(struct protocol_stack *stack)
 {
     struct rte_gro_param gro_param = {
-        .gro_types = RTE_GRO_TCP_IPV4,
-        /* 8*16=128(max) */
-        .max_flow_num = 8,
-        .max_item_per_flow = 16,
+        .gro_types = VDEV_GRO_TYPES,
+        .max_flow_num = get_global_cfg_params()->gro_max_flow_num,
+        .max_item_per_flow = get_global_cfg_params()->gro_max_item_per_flow,
+        .socket_id = stack->numa_id,
     };
 
+    stack->gro_ctx = rte_gro_ctx_create(&gro_param);
+    if (stack->gro_ctx == NULL) {
+        LSTACK_LOG(ERR, LSTACK, "stack %u rte_gro_ctx_create failed\n", stack->stack_idx);
+        return -1;
+    }
+    return 0;
+}
+
+void vdev_gro_exit(struct protocol_stack *stack)
+{
+    if (stack->gro_ctx != NULL) {
+        rte_gro_ctx_destroy(stack->gro_ctx);
+        stack->gro_ctx = NULL;
+    }
+}
+
+static uint32_t vdev_rx_poll(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t max_mbuf)
+{
     uint32_t pkt_num = rte_eth_rx_burst(stack->port_id, stack->queue_id, pkts, max_mbuf);
     vdev_pkts_parse(pkts, pkt_num);
+    if (get_global_cfg_params()->rss_rebalance_interval != 0) {
+        /* before gro, which merges packets */
+        dpdk_rss_reta_account(stack, pkts, pkt_num);
+    }
+
+    uint64_t sw_ol = dpdk_sw_rx_cksum_ol();
+    if (sw_ol != 0) {
+        pkt_num = vdev_pkts_cksum_verify(stack, pkts, pkt_num, sw_ol);
+    }
     if (pkt_num <= 1) {
         return pkt_num;
     }
 
-    if (get_protocol_stack_group()->rx_offload == 0 || /* skip gro when tcp/ip cksum offloads disable */
+    /* skip gro when tcp/ip cksum are verified neither by nic nor in software */
+    if ((get_protocol_stack_group()->rx_offload | sw_ol) == 0 ||
         xdp_eth_enabled() || /* kernel has done GRO */
         (get_global_cfg_params()->vlan_mode >= 0
             && !(get_protocol_stack_group()->rx_offload & RTE_ETH_RX_OFFLOAD_VLAN_STRIP))) {
         return pkt_num;
     }
 
-    pkt_num =  rte_gro_reassemble_burst(pkts, pkt_num, &gro_param);
+    void *gro_ctx = stack->gro_ctx;
+    if (gro_ctx == NULL) {
+        return pkt_num;
+    }
+
+    uint32_t gro_in = pkt_num;
+    pkt_num = rte_gro_reassemble(pkts, pkt_num, gro_ctx);
+    pkt_num += rte_gro_timeout_flush(gro_ctx, 0, VDEV_GRO_TYPES, pkts + pkt_num, max_mbuf - pkt_num);
 
+    stack->stats.gro_pkts += gro_in;
+    stack->stats.gro_merged += gro_in - pkt_num;
     return pkt_num;
 }
 
-static uint32_t ltran_tx_xmit(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts)
+/* packets nic or ltran ring did not take, sent in order before new packets on later polls */
+struct vdev_tx_backlog {
+    uint32_t head;
+    uint32_t tail;
+    struct rte_mbuf *pkts[VDEV_TX_BACKLOG_SIZE];
+    uint32_t stamp[VDEV_TX_BACKLOG_SIZE];
+};
+static struct vdev_tx_backlog g_tx_backlog[PROTOCOL_STACK_MAX];
+
+typedef uint32_t (*vdev_tx_once_fn)(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts);
+
+static uint32_t ltran_tx_once(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts)
 {
-    uint32_t sent_pkts = 0;
+    uint32_t sent_pkts;
     struct rte_mbuf *free_buf[DPDK_PKT_BURST_SIZE];
-    const uint32_t tbegin = sys_now();
 
-    do {
-        if (unlikely(stack->tx_ring_used >= INUSE_TX_PKTS_WATERMARK)) {
-            uint32_t free_pkts = gazelle_ring_sc_dequeue(stack->tx_ring, (void **)free_buf, stack->tx_ring_used);
-            for (uint32_t i = 0; i < free_pkts; i++) {
-                rte_pktmbuf_free(free_buf[i]);
-            }
-            stack->tx_ring_used -= free_pkts;
-        }
+    if (!get_register_state()) {
+        return 0;
+    }
 
-        sent_pkts += gazelle_ring_sp_enqueue(stack->tx_ring, (void **)(&pkts[sent_pkts]), nr_pkts - sent_pkts);
-    } while ((sent_pkts < nr_pkts) && (ENQUEUE_RING_RETRY_TIMEOUT > sys_now() - tbegin) && get_register_state());
+    if (unlikely(stack->tx_ring_used >= INUSE_TX_PKTS_WATERMARK)) {
+        uint32_t free_pkts = gazelle_ring_sc_dequeue(stack->tx_ring, (void **)free_buf, stack->tx_ring_used);
+        for (uint32_t i = 0; i < free_pkts; i++) {
+            rte_pktmbuf_free(free_buf[i]);
+        }
+        stack->tx_ring_used -= free_pkts;
+    }
 
+    sent_pkts = gazelle_ring_sp_enqueue(stack->tx_ring, (void **)pkts, nr_pkts);
     stack->tx_ring_used += sent_pkts;
     return sent_pkts;
 }
 
-uint32_t vdev_tx_xmit(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts)
+static uint32_t vdev_tx_once(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts)
+{
+    return rte_eth_tx_burst(stack->port_id, stack->queue_id, pkts, nr_pkts);
+}
+
+/* eth_dev_output leaves a packet alone while it is marked, see vdev_tx_backlogged */
+static inline void vdev_tx_backlog_mark(struct rte_mbuf *m, uint8_t mark)
+{
+    for (; m != NULL; m = m->next) {
+        mbuf_to_private(m)->tx_backlog = mark;
+    }
+}
+
+static inline void vdev_tx_backlog_mark_range(struct vdev_tx_backlog *backlog, uint32_t from, uint32_t to,
+    uint8_t mark)
+{
+    for (uint32_t i = from; i != to; i++) {
+        vdev_tx_backlog_mark(backlog->pkts[i & VDEV_TX_BACKLOG_MASK], mark);
+    }
+}
+
+/*
+ * a packet the nic has not taken for VDEV_TX_BACKLOG_HOLD_MS is dropped and counted in tx_backlog_drop.
+ * lwip still holds unacked tcp segments and retransmits them, other frames (udp, arp, ...) are lost
+ * as they would be on a full nic queue.
+ */
+static void vdev_tx_backlog_expire(struct protocol_stack *stack, struct vdev_tx_backlog *backlog)
+{
+    uint32_t now = sys_now();
+
+    while (backlog->head != backlog->tail) {
+        uint32_t idx = backlog->head & VDEV_TX_BACKLOG_MASK;
+        if (now - backlog->stamp[idx] <= VDEV_TX_BACKLOG_HOLD_MS) {
+            break;
+        }
+        vdev_tx_backlog_mark(backlog->pkts[idx], 0);
+        rte_pktmbuf_free(backlog->pkts[idx]);
+        backlog->head++;
+        stack->stats.tx_backlog_drop++;
+    }
+}
+
+static void vdev_tx_backlog_send(struct protocol_stack *stack, vdev_tx_once_fn tx_once)
+{
+    struct vdev_tx_backlog *backlog = &g_tx_backlog[stack->stack_idx];
+
+    vdev_tx_backlog_expire(stack, backlog);
+    while (backlog->head != backlog->tail) {
+        uint32_t start = backlog->head & VDEV_TX_BACKLOG_MASK;
+        uint32_t num = backlog->tail - backlog->head;
+        if (num > VDEV_TX_BACKLOG_SIZE - start) {
+            num = VDEV_TX_BACKLOG_SIZE - start;
+        }
+
+        /* unmark before the hand-off, the nic or ltran may free the packets at once */
+        vdev_tx_backlog_mark_range(backlog, backlog->head, backlog->head + num, 0);
+        uint32_t sent_pkts = tx_once(stack, &backlog->pkts[start], num);
+        backlog->head += sent_pkts;
+        if (sent_pkts < num) {
+            vdev_tx_backlog_mark_range(backlog, backlog->head, backlog->head + num - sent_pkts, 1);
+            break;
+        }
+    }
+}
+
+/* never spins on a full queue: what is not taken now waits in backlog, and when backlog is full too
+ * the short count makes eth_dev_output return ERR_MEM, so lwip keeps the segments and sends them later */
+static uint32_t vdev_tx_backlog_xmit(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts,
+    vdev_tx_once_fn tx_once)
 {
+    struct vdev_tx_backlog *backlog = &g_tx_backlog[stack->stack_idx];
     uint32_t sent_pkts = 0;
 
+    vdev_tx_backlog_send(stack, tx_once);
+    if (likely(backlog->head == backlog->tail)) {
+        sent_pkts = tx_once(stack, pkts, nr_pkts);
+    }
+
+    uint32_t now = sys_now();
+    while (sent_pkts < nr_pkts && backlog->tail - backlog->head < VDEV_TX_BACKLOG_SIZE) {
+        backlog->pkts[backlog->tail & VDEV_TX_BACKLOG_MASK] = pkts[sent_pkts];
+        backlog->stamp[backlog->tail & VDEV_TX_BACKLOG_MASK] = now;
+        vdev_tx_backlog_mark(pkts[sent_pkts], 1);
+        backlog->tail++;
+        sent_pkts++;
+        stack->stats.tx_backlog++;
+    }
+
+    return sent_pkts;
+}
+
+void vdev_tx_flush(struct protocol_stack *stack)
+{
+    struct vdev_tx_backlog *backlog = &g_tx_backlog[stack->stack_idx];
+
+    if (likely(backlog->head == backlog->tail)) {
+        return;
+    }
+    vdev_tx_backlog_send(stack, use_ltran() ? ltran_tx_once : vdev_tx_once);
+}
+
+uint32_t vdev_tx_pending(uint16_t stack_idx)
+{
+    return g_tx_backlog[stack_idx].tail - g_tx_backlog[stack_idx].head;
+}
+
+bool vdev_tx_backlogged(const struct pbuf *p)
+{
+    for (; p != NULL; p = p->next) {
+        if (pbuf_to_private(p)->tx_backlog != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t ltran_tx_xmit(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts)
+{
+    return vdev_tx_backlog_xmit(stack, pkts, nr_pkts, ltran_tx_once);
+}
+
+uint32_t vdev_tx_xmit(struct protocol_stack *stack, struct rte_mbuf **pkts, uint32_t nr_pkts)
+{
     if (rte_eth_tx_prepare(stack->port_id, stack->queue_id, pkts, nr_pkts) != nr_pkts) {
         stack->stats.tx_prepare_fail++;
         LSTACK_LOG(INFO, LSTACK, "rte_eth_tx_prepare failed\n");
     }
-    const uint32_t tbegin = sys_now();
-
-    do {
-        sent_pkts += rte_eth_tx_burst(stack->port_id, stack->queue_id, &pkts[sent_pkts], nr_pkts - sent_pkts);
-    } while (sent_pkts < nr_pkts && (ENQUEUE_RING_RETRY_TIMEOUT > sys_now() - tbegin));
 
-    return sent_pkts;
+    return vdev_tx_backlog_xmit(stack, pkts, nr_pkts, vdev_tx_once);
 }
 
 int32_t vdev_reg_xmit(enum reg_ring_type type, struct gazelle_quintuple *qtuple)
@@ -137,6 +137,7 @@ static void gazelle_print_ltran_conn(void *buf, const struct gazelle_stat_msg_re
 static void gazelle_print_lstack_xstats(void *buf, const struct gazelle_stat_msg_request *req_msg);
 static void gazelle_print_lstack_aggregate(void *buf, const struct gazelle_stat_msg_request *req_msg);
 static void gazelle_print_lstack_nic_features(void *buf, const struct gazelle_stat_msg_request *req_msg);
+static void gazelle_print_lstack_mem(void *buf, const struct gazelle_stat_msg_request *req_msg);
 static void gazelle_print_lstack_stat_proto(void *buf, const struct gazelle_stat_msg_request *req_msg);
 static void gazelle_print_lstack_stat_intr(void *buf, const struct gazelle_stat_msg_request *req_msg);
 
@@ -174,6 +175,7 @@ static struct gazelle_dfx_list g_gazelle_dfx_tbl[] = {
     {GAZELLE_STAT_LSTACK_SHOW_NIC_FEATURES, sizeof(struct gazelle_stack_dfx_data), gazelle_print_lstack_nic_features},
     {GAZELLE_STAT_LSTACK_SHOW_PROTOCOL,    sizeof(struct gazelle_stack_dfx_data),  gazelle_print_lstack_stat_proto},
     {GAZELLE_STAT_LSTACK_SHOW_INTR,    sizeof(struct gazelle_stack_dfx_data),  gazelle_print_lstack_stat_intr},
+    {GAZELLE_STAT_LSTACK_SHOW_MEM,     sizeof(struct gazelle_stack_dfx_data),  gazelle_print_lstack_mem},
     
 #ifdef GAZELLE_FAULT_INJECT_ENABLE
     {GAZELLE_STAT_FAULT_INJECT_SET, sizeof(struct gazelle_stack_dfx_data), gazelle_print_fault_inject_set_status},
@@ -249,6 +251,23 @@ static void gazelle_print_lstack_nic_features(void *buf, const struct gazelle_st
     printf("rx-vlan-strip: %s\n", (f->rx_offload & RTE_ETH_RX_OFFLOAD_VLAN_STRIP) ? "on" : "off");
 }
 
+static void gazelle_print_lstack_mem(void *buf, const struct gazelle_stat_msg_request *req_msg)
+{
+    struct gazelle_stat_lstack_mem *mem = &(((struct gazelle_stack_dfx_data *)buf)->data.mem_stats);
+
+    printf("numa   stacks  mempools  mempool(KB)     heap_alloc(KB)  heap_total(KB)\n");
+    for (uint32_t i = 0; i < mem->node_num && i < NUMA_MEM_STAT_MAX; i++) {
+        struct numa_mem_stats *node = &mem->node[i];
+        if (node->numa_id < 0) {
+            printf("%-7s", "any");
+        } else {
+            printf("%-7d", node->numa_id);
+        }
+        printf("%-8u%-10u%-16"PRIu64"%-16"PRIu64"%-16"PRIu64"\n", node->stack_num, node->mempool_num,
+            node->mempool_bytes / 1024, node->heap_alloc / 1024, node->heap_total / 1024);
+    }
+}
+
 static void gazelle_print_ltran_conn(void *buf, const struct gazelle_stat_msg_request *req_msg)
 {
     struct gazelle_stat_forward_table *table = (struct gazelle_stat_forward_table *)buf;
@@ -755,6 +774,23 @@ static void show_lstack_stats(struct gazelle_stack_dfx_data *lstack_stat)
     printf("accpet_fail: %-16"PRIu64" ", lstack_stat->data.pkts.stack_stat.accept_fail);
     printf("sock_rx_drop: %-15"PRIu64" ", lstack_stat->data.pkts.stack_stat.sock_rx_drop);
     printf("sock_tx_merge: %-16"PRIu64" \n", lstack_stat->data.pkts.stack_stat.sock_tx_merge);
+    printf("stack_load: %-16u%% ", lstack_stat->data.pkts.stack_load);
+    printf("tx_backlog: %-16"PRIu64" ", lstack_stat->data.pkts.stack_stat.tx_backlog);
+    printf("timer_run_max_us: %-10"PRIu64" \n", lstack_stat->data.pkts.stack_stat.timer_run_max_us);
+    uint64_t mbuf_alloc = lstack_stat->data.pkts.stack_stat.mbuf_cache_hit +
+        lstack_stat->data.pkts.stack_stat.mbuf_cache_miss;
+    printf("mbuf_cache_hit: %-12"PRIu64" ", lstack_stat->data.pkts.stack_stat.mbuf_cache_hit);
+    printf("mbuf_cache_miss: %-12"PRIu64" ", lstack_stat->data.pkts.stack_stat.mbuf_cache_miss);
+    printf("mbuf_cache_hit_rate: %-7"PRIu64"%% \n",
+        mbuf_alloc == 0 ? 0 : lstack_stat->data.pkts.stack_stat.mbuf_cache_hit * 100 / mbuf_alloc);
+    printf("mbuf_ring_low: %-14"PRIu64" ", lstack_stat->data.pkts.stack_stat.mbuf_ring_low);
+    printf("gro_merged: %-16"PRIu64" ", lstack_stat->data.pkts.stack_stat.gro_merged);
+    printf("gro_merge_rate: %-12"PRIu64"%% \n", lstack_stat->data.pkts.stack_stat.gro_pkts == 0 ? 0 :
+        lstack_stat->data.pkts.stack_stat.gro_merged * 100 / lstack_stat->data.pkts.stack_stat.gro_pkts);
+    printf("rx_cksum_bad: %-15"PRIu64" ", lstack_stat->data.pkts.stack_stat.rx_cksum_bad);
+    printf("udp_gso_segs: %-14"PRIu64" ", lstack_stat->data.pkts.stack_stat.udp_gso_segs);
+    printf("syn_drop: %-18"PRIu64" \n", lstack_stat->data.pkts.stack_stat.syn_drop);
+    printf("tx_backlog_drop: %-11"PRIu64" \n", lstack_stat->data.pkts.stack_stat.tx_backlog_drop);
 }
 
 static void gazelle_print_lstack_stat_detail(struct gazelle_stack_dfx_data *lstack_stat,
@@ -1271,12 +1307,15 @@ static void gazelle_print_lstack_stat_conn(void *buf, const struct gazelle_stat_
     printf("Active Internet connections (servers and established)\n");
     do {
         printf("\n------ stack tid: %6u ------time=%s\n", stat->tid, sys_local_time_str);
-        printf("No.   Proto lwip_recv recv_ring in_send send_ring cwn      rcv_wnd  snd_wnd   snd_buf   snd_nxt"
+        printf("No.   Proto lwip_recv recv_ring in_send send_ring idle_mbuf sock_mem "
+            "cwn      rcv_wnd  snd_wnd   snd_buf   snd_nxt"
             "        lastack        rcv_nxt        events    epoll_ev  evlist fd     Local Address"
             "                                        Foreign Address                                      State"
             "     keep-alive keep-alive(idle,intvl,cnt) pingpong\n");
         uint32_t unread_pkts = 0;
         uint32_t unsend_pkts = 0;
+        uint32_t idle_mbufs = 0;
+        uint64_t sock_mem = 0;
         for (i = 0; i < conn->conn_num && i < GAZELLE_LSTACK_MAX_CONN; i++) {
             struct gazelle_stat_lstack_conn_info *conn_info = &conn->conn_list[i];
 
@@ -1292,11 +1331,12 @@ static void gazelle_print_lstack_stat_conn(void *buf, const struct gazelle_stat_
                 
                 sprintf_s(str_laddr, sizeof(str_laddr), "%s:%hu", str_ip, conn_info->l_port);
                 sprintf_s(str_raddr, sizeof(str_raddr), "%s:%hu", str_rip, conn_info->r_port);
-                printf("%-6utcp   %-10u%-10u%-8u%-10u%-9d%-9d%-10d%-10d%-15u%-15u%-15u%-10x%-10x%-7d%-7d"
+                printf("%-6utcp   %-10u%-10u%-8u%-10u%-10u%-9u%-9d%-9d%-10d%-10d%-15u%-15u%-15u%-10x%-10x%-7d%-7d"
                     "%-52s %-52s %s  %-5d %s  %d\n",
                     i, conn_info->recv_cnt, conn_info->recv_ring_cnt, conn_info->in_send,
-                    conn_info->send_ring_cnt, conn_info->cwn, conn_info->rcv_wnd, conn_info->snd_wnd,
-                    conn_info->snd_buf, conn_info->snd_nxt, conn_info->lastack, conn_info->rcv_nxt, conn_info->events,
+                    conn_info->send_ring_cnt, conn_info->send_ring_idle, conn_info->sock_mem,
+                    conn_info->cwn, conn_info->rcv_wnd, conn_info->snd_wnd, conn_info->snd_buf,
+                    conn_info->snd_nxt, conn_info->lastack, conn_info->rcv_nxt, conn_info->events,
                     conn_info->epoll_events, conn_info->eventlist, conn_info->fd,
                     str_laddr, str_raddr, tcp_state_to_str(conn_info->tcp_sub_state),
                     conn_info->keepalive, keepalive_info_str, conn_info->pingpong);
@@ -1304,7 +1344,7 @@ static void gazelle_print_lstack_stat_conn(void *buf, const struct gazelle_stat_
                 inet_ntop(domain, lip, str_ip, sizeof(str_ip));
                 sprintf_s(str_laddr, sizeof(str_laddr), "%s:%hu", str_ip, conn_info->l_port);
                 sprintf_s(str_raddr, sizeof(str_raddr), "%s:*", domain == AF_INET ? "0.0.0.0" : "::0");
-                printf("%-6utcp    %-147u%-7d%-52s %-52s LISTEN\n", i, conn_info->recv_cnt,
+                printf("%-6utcp    %-166u%-7d%-52s %-52s LISTEN\n", i, conn_info->recv_cnt,
                     conn_info->fd, str_laddr, str_raddr);
             } else {
                 printf("Got unknow tcp conn::%s:%5hu, state:%u\n",
@@ -1312,9 +1352,12 @@ static void gazelle_print_lstack_stat_conn(void *buf, const struct gazelle_stat_
             }
             unread_pkts += conn_info->recv_ring_cnt + conn_info->recv_cnt;
             unsend_pkts += conn_info->send_ring_cnt + conn_info->in_send;
+            idle_mbufs += conn_info->send_ring_idle;
+            sock_mem += conn_info->sock_mem;
         }
         if (conn->conn_num > 0) {
-            printf("Total unread pkts:%u  unsend pkts:%u\n", unread_pkts, unsend_pkts);
+            printf("Total unread pkts:%u  unsend pkts:%u  idle mbufs:%u  sock mem:%"PRIu64"KB\n",
+                unread_pkts, unsend_pkts, idle_mbufs, sock_mem / 1024);
         }
 
         if (i < conn->total_conn_num) {
@@ -1360,6 +1403,7 @@ static void show_usage(void)
            "  -l, latency     [time]   show lstack latency \n"
            "  -x, xstats      show lstack xstats \n"
            "  -k, nic-features     show state of protocol offload and other features \n"
+           "  -m, memory      show lstack hugepage memory per numa node \n"
            "  -a, aggregatin  [time]   show lstack send/recv aggregation \n"
            "  -p, protocol    {UDP | TCP | ICMP | IP | ETHARP} show lstack protocol statistics \n"
            "  set: \n"
@@ -1639,6 +1683,8 @@ static int32_t parse_dfx_lstack_show_args(int32_t argc, char *argv[], struct gaz
         }
     } else if (strcmp(param, "-k") == 0 || strcmp(param, "nic-features") == 0) {
         req_msg[cmd_index++].stat_mode = GAZELLE_STAT_LSTACK_SHOW_NIC_FEATURES;
+    } else if (strcmp(param, "-m") == 0 || strcmp(param, "memory") == 0) {
+        req_msg[cmd_index++].stat_mode = GAZELLE_STAT_LSTACK_SHOW_MEM;
     } else if (strcmp(param, "protocol") == 0 || strcmp(param, "-p") == 0) {
 	    cmd_index = parse_dfx_lstack_show_proto_args(argc, argv, req_msg);
     }
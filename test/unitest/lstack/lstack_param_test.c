@@ -151,6 +151,116 @@ void test_lstack_bad_params_devices(void)
     CU_ASSERT(lstack_bad_param("/^devices/cdevices=\"ff:ff:ff:ff:ff:fg\"/") != 0);
 }
 
+void test_lstack_bad_params_stack_rebalance(void)
+{
+    /* lstack start stack_rebalance exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nstack_rebalance=2/") != 0);
+}
+
+void test_lstack_bad_params_listen_reuseport(void)
+{
+    /* lstack start listen_reuseport alone */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nlisten_reuseport=1/") == 0);
+
+    /* lstack start listen_reuseport exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nlisten_reuseport=2/") != 0);
+
+    /* lstack start listen_reuseport with ltran */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=1\\nlisten_reuseport=1/") != 0);
+
+    /* lstack start listen_reuseport with listen_shadow */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nlisten_shadow=1\\nlisten_reuseport=1/") != 0);
+
+    /* lstack start listen_reuseport with tuple_filter */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\ntuple_filter=1\\nlisten_reuseport=1/") != 0);
+
+    /* lstack start listen_reuseport in rtc mode */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nstack_thread_mode=\"run-to-completion\"\\n"
+        "listen_reuseport=1/") != 0);
+}
+
+void test_lstack_bad_params_rtc_epoll_rx_batch(void)
+{
+    /* lstack start rtc_epoll_rx_batch exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nrtc_epoll_rx_batch=65536/") != 0);
+}
+
+void test_lstack_bad_params_flow_bifurcation_thread(void)
+{
+    /* lstack start flow_bifurcation_thread without flow_bifurcation */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nflow_bifurcation_thread=1/") != 0);
+}
+
+void test_lstack_bad_params_fork_defer_init(void)
+{
+    /* lstack start fork_defer_init with ltran */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=1\\nfork_defer_init=1/") != 0);
+}
+
+void test_lstack_bad_params_conn_compact(void)
+{
+    /* lstack start conn_compact exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nconn_compact=2/") != 0);
+}
+
+void test_lstack_bad_params_gro(void)
+{
+    /* lstack start gro_max_flow_num exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\ngro_max_flow_num=0/") != 0);
+
+    /* lstack start gro_max_item_per_flow exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\ngro_max_item_per_flow=65/") != 0);
+
+    /* lstack start gro table far larger than nic_read_number */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\ngro_max_flow_num=64\\ngro_max_item_per_flow=16/") != 0);
+
+    /* lstack start small nic_read_number with default gro table */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nnic_read_number=16/") == 0);
+}
+
+void test_lstack_bad_params_rx_sw_cksum(void)
+{
+    /* lstack start rx_sw_cksum alone */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nrx_sw_cksum=1/") == 0);
+
+    /* lstack start rx_sw_cksum with ltran */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=1\\nrx_sw_cksum=1/") != 0);
+}
+
+void test_lstack_bad_params_syn_watermark(void)
+{
+    /* lstack start syn_watermark alone */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nsyn_watermark=80/") == 0);
+
+    /* lstack start syn_watermark exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nsyn_watermark=101/") != 0);
+
+    /* lstack start syn_watermark with ltran */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=1\\nsyn_watermark=80/") != 0);
+}
+
+void test_lstack_bad_params_rss_rebalance(void)
+{
+    /* lstack start rss_rebalance_interval alone */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nrss_rebalance_interval=10/") == 0);
+
+    /* lstack start rss_rebalance_interval exceed range */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nrss_rebalance_interval=3601/") != 0);
+
+    /* lstack start rss_rebalance_interval with ltran */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=1\\nrss_rebalance_interval=10/") != 0);
+
+    /* lstack start rss_rebalance_interval with tuple_filter */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\ntuple_filter=1\\nrss_rebalance_interval=10/") != 0);
+
+    /* lstack start rss_rebalance_interval in rtc mode */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nstack_thread_mode=\"run-to-completion\"\\n"
+        "rss_rebalance_interval=10/") != 0);
+
+    /* lstack start rss_rebalance_interval with multiple processes */
+    CU_ASSERT(lstack_bad_param("s/^use_ltran=0/use_ltran=0\\nnum_process=2\\nrss_rebalance_interval=10/") != 0);
+}
+
 void test_lstack_normal_param(void)
 {
     int ret;
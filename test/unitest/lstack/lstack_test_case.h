@@ -20,5 +20,15 @@ void test_lstack_bad_params_mask_addr(void);
 void test_lstack_bad_params_host_addr(void);
 void test_lstack_bad_params_num_cpus(void);
 void test_lstack_bad_params_lowpower(void);
+void test_lstack_bad_params_stack_rebalance(void);
+void test_lstack_bad_params_listen_reuseport(void);
+void test_lstack_bad_params_rtc_epoll_rx_batch(void);
+void test_lstack_bad_params_flow_bifurcation_thread(void);
+void test_lstack_bad_params_fork_defer_init(void);
+void test_lstack_bad_params_conn_compact(void);
+void test_lstack_bad_params_gro(void);
+void test_lstack_bad_params_rx_sw_cksum(void);
+void test_lstack_bad_params_syn_watermark(void);
+void test_lstack_bad_params_rss_rebalance(void);
 
 #endif
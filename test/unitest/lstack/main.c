@@ -49,6 +49,16 @@ int main(int argc, char **argv)
     (void)CU_ADD_TEST(suite, test_lstack_bad_params_host_addr);
     (void)CU_ADD_TEST(suite, test_lstack_bad_params_num_cpus);
     (void)CU_ADD_TEST(suite, test_lstack_bad_params_lowpower);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_stack_rebalance);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_listen_reuseport);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_rtc_epoll_rx_batch);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_flow_bifurcation_thread);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_fork_defer_init);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_conn_compact);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_gro);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_rx_sw_cksum);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_syn_watermark);
+    (void)CU_ADD_TEST(suite, test_lstack_bad_params_rss_rebalance);
 
     switch (g_cunit_mode) {
         case LSTACK_SCREEN: